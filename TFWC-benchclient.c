@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "xdg-shell-client-protocol.h"
+
+//synthetic wl_shm client for the TFWC benchmark mode, it opens a number of toplevels
+//and commits to all of them at a fixed rate, each commit moves a small square so only a bit of every window is damaged
+
+#define squareSize 64
+
+struct benchBuffer {
+    struct wl_buffer *buffer;
+    uint32_t *data;
+    bool busy;
+    int squareX, squareY; //where the square was last drawn into this buffer
+};
+
+struct benchWindow {
+    struct benchClient *client;
+    struct wl_surface *surface;
+    struct xdg_surface *xdgSurface;
+    struct xdg_toplevel *toplevel;
+    int width, height;
+    bool configured;
+    struct benchBuffer buffers[2];
+    int squareX, squareY; //where the square is on screen right now
+    uint32_t frame;
+};
+
+struct benchClient {
+    struct wl_display *display;
+    struct wl_compositor *compositor;
+    struct wl_shm *shm;
+    struct xdg_wm_base *wmBase;
+    struct benchWindow *windows;
+    int count, rate;
+};
+
+//helper functions
+
+static void fillRect(struct benchBuffer *buffer, int stride, int x, int y, int w, int h, uint32_t color) {
+    for(int row = y; row < y + h; row++) {
+        for(int col = x; col < x + w; col++) buffer->data[row * stride + col] = color;
+    }
+}
+
+static uint32_t windowColor(struct benchWindow *window) {
+    uint32_t index = window - window->client->windows;
+    return 0xff000000 | ((index * 0x3f1e2d) & 0x00ffffff);
+}
+
+//buffer stuff
+
+static void bufferRelease(void *data, struct wl_buffer *wlBuffer) {
+    struct benchBuffer *buffer = data;
+    buffer->busy = false;
+}
+
+static const struct wl_buffer_listener bufferListener = {
+    .release = bufferRelease,
+};
+
+//allocates both buffers of a window out of a single shm pool
+static bool createBuffers(struct benchWindow *window) {
+    int stride = window->width * 4;
+    int size = stride * window->height;
+    int fd = memfd_create("tfwc-bench", MFD_CLOEXEC);
+    if(fd < 0) return false;
+    if(ftruncate(fd, size * 2) < 0) {
+        close(fd);
+        return false;
+    }
+    uint32_t *data = mmap(NULL, size * 2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    struct wl_shm_pool *pool = wl_shm_create_pool(window->client->shm, fd, size * 2);
+    for(int i = 0; i < 2; i++) {
+        struct benchBuffer *buffer = &window->buffers[i];
+        buffer->data = data + i * (size / 4);
+        buffer->buffer = wl_shm_pool_create_buffer(pool, i * size, window->width, window->height, stride, WL_SHM_FORMAT_XRGB8888);
+        wl_buffer_add_listener(buffer->buffer, &bufferListener, buffer);
+        buffer->squareX = buffer->squareY = 0;
+        fillRect(buffer, window->width, 0, 0, window->width, window->height, windowColor(window));
+    }
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return true;
+}
+
+//window stuff
+
+//moves the square and commits, only the old and new square get damaged
+static void drawWindow(struct benchWindow *window, bool full) {
+    struct benchBuffer *buffer = NULL;
+    for(int i = 0; i < 2 && buffer == NULL; i++) {
+        if(!window->buffers[i].busy) buffer = &window->buffers[i];
+    }
+    if(buffer == NULL) return; //the compositor is behind, skip this tick
+
+    int stride = window->width;
+    int rangeX = window->width - squareSize, rangeY = window->height - squareSize;
+    window->frame++;
+    int x = (window->frame * 7) % rangeX;
+    int y = (window->frame * 5) % rangeY;
+
+    //the buffer still has the square from when it was last used, and the screen has the one from the last commit
+    fillRect(buffer, stride, buffer->squareX, buffer->squareY, squareSize, squareSize, windowColor(window));
+    fillRect(buffer, stride, x, y, squareSize, squareSize, ~windowColor(window) | 0xff000000);
+
+    wl_surface_attach(window->surface, buffer->buffer, 0, 0);
+    if(full) {
+        wl_surface_damage_buffer(window->surface, 0, 0, window->width, window->height);
+    } else {
+        wl_surface_damage_buffer(window->surface, window->squareX, window->squareY, squareSize, squareSize);
+        wl_surface_damage_buffer(window->surface, x, y, squareSize, squareSize);
+    }
+    wl_surface_commit(window->surface);
+    buffer->busy = true;
+    buffer->squareX = window->squareX = x;
+    buffer->squareY = window->squareY = y;
+}
+
+static void xdgSurfaceConfigure(void *data, struct xdg_surface *xdgSurface, uint32_t serial) {
+    struct benchWindow *window = data;
+    xdg_surface_ack_configure(xdgSurface, serial);
+    if(window->configured) return;
+    window->configured = true;
+    drawWindow(window, true);
+}
+
+static const struct xdg_surface_listener xdgSurfaceListener = {
+    .configure = xdgSurfaceConfigure,
+};
+
+//the compositor gets no say in the size, the benchmark needs the same load every run
+static void xdgToplevelConfigure(void *data, struct xdg_toplevel *toplevel, int32_t width, int32_t height, struct wl_array *states) {
+}
+
+static void xdgToplevelClose(void *data, struct xdg_toplevel *toplevel) {
+}
+
+static const struct xdg_toplevel_listener xdgToplevelListener = {
+    .configure = xdgToplevelConfigure,
+    .close = xdgToplevelClose,
+};
+
+static bool createWindow(struct benchClient *client, struct benchWindow *window, int index) {
+    window->client = client;
+    window->width = 320 + (index * 37) % 480;
+    window->height = 240 + (index * 53) % 360;
+    if(!createBuffers(window)) return false;
+
+    window->surface = wl_compositor_create_surface(client->compositor);
+    struct wl_region *opaque = wl_compositor_create_region(client->compositor);
+    wl_region_add(opaque, 0, 0, window->width, window->height);
+    wl_surface_set_opaque_region(window->surface, opaque);
+    wl_region_destroy(opaque);
+
+    window->xdgSurface = xdg_wm_base_get_xdg_surface(client->wmBase, window->surface);
+    xdg_surface_add_listener(window->xdgSurface, &xdgSurfaceListener, window);
+    window->toplevel = xdg_surface_get_toplevel(window->xdgSurface);
+    xdg_toplevel_add_listener(window->toplevel, &xdgToplevelListener, window);
+    xdg_toplevel_set_title(window->toplevel, "tfwc-bench");
+    wl_surface_commit(window->surface);
+    return true;
+}
+
+//global stuff
+
+static void wmBasePing(void *data, struct xdg_wm_base *wmBase, uint32_t serial) {
+    xdg_wm_base_pong(wmBase, serial);
+}
+
+static const struct xdg_wm_base_listener wmBaseListener = {
+    .ping = wmBasePing,
+};
+
+static void registryGlobal(void *data, struct wl_registry *registry, uint32_t name, const char *interface, uint32_t version) {
+    struct benchClient *client = data;
+    if(strcmp(interface, wl_compositor_interface.name) == 0) {
+        client->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+    } else if(strcmp(interface, wl_shm_interface.name) == 0) {
+        client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if(strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        client->wmBase = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(client->wmBase, &wmBaseListener, client);
+    }
+}
+
+static void registryGlobalRemove(void *data, struct wl_registry *registry, uint32_t name) {
+}
+
+static const struct wl_registry_listener registryListener = {
+    .global = registryGlobal,
+    .global_remove = registryGlobalRemove,
+};
+
+static int64_t nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+//main function
+int main(int argc, char *argv[]) {
+    struct benchClient client = {
+        .count = 16,
+        .rate = 60,
+    };
+    int opt;
+    while((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch(opt) {
+            case 'n':
+                client.count = atoi(optarg);
+                break;
+            case 'r':
+                client.rate = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n windows] [-r commits per second]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(client.count < 1 || client.rate < 1) return 1;
+
+    client.display = wl_display_connect(NULL);
+    if(client.display == NULL) {
+        fprintf(stderr, "failed to connect to the compositor\n");
+        return 1;
+    }
+    struct wl_registry *registry = wl_display_get_registry(client.display);
+    wl_registry_add_listener(registry, &registryListener, &client);
+    wl_display_roundtrip(client.display);
+    if(client.compositor == NULL || client.shm == NULL || client.wmBase == NULL) {
+        fprintf(stderr, "compositor is missing required globals\n");
+        return 1;
+    }
+
+    client.windows = calloc(client.count, sizeof(struct benchWindow));
+    for(int i = 0; i < client.count; i++) {
+        if(!createWindow(&client, &client.windows[i], i)) {
+            fprintf(stderr, "failed to create window %d\n", i);
+            return 1;
+        }
+    }
+
+    //commit to every window once per tick until the compositor goes away
+    int64_t interval = 1000 / client.rate, next = nowMs() + interval;
+    struct pollfd pfd = { .fd = wl_display_get_fd(client.display), .events = POLLIN };
+    while(true) {
+        while(wl_display_prepare_read(client.display) != 0) wl_display_dispatch_pending(client.display);
+        if(wl_display_flush(client.display) < 0 && errno != EAGAIN) {
+            wl_display_cancel_read(client.display);
+            break;
+        }
+        int64_t timeout = next - nowMs();
+        int ret = poll(&pfd, 1, timeout > 0 ? timeout : 0);
+        if(ret < 0 && errno != EINTR) {
+            wl_display_cancel_read(client.display);
+            break;
+        }
+        if(ret > 0) {
+            if(wl_display_read_events(client.display) < 0) break;
+        } else {
+            wl_display_cancel_read(client.display);
+        }
+        if(wl_display_dispatch_pending(client.display) < 0) break;
+
+        if(nowMs() >= next) {
+            next += interval;
+            for(int i = 0; i < client.count; i++) {
+                if(client.windows[i].configured) drawWindow(&client.windows[i], false);
+            }
+        }
+    }
+
+    wl_display_disconnect(client.display);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef TFWC_IPC_H
+#define TFWC_IPC_H
+
+#include <stdint.h>
+
+//protocol of the TFWC control socket, its path is in TFWC_SOCKET for every program the compositor starts
+//every message is a header followed by length bytes of body, everything is in host byte order since it never leaves the machine
+
+//messages to the compositor can be at most this big, a batch of 65536 operations fits
+#define TFWC_IPC_MAX_MESSAGE (1 << 20)
+
+struct TFWCIpcHeader {
+    uint32_t type;
+    uint32_t length;
+};
+
+enum TFWCIpcType {
+    TFWC_IPC_LIST = 1, //no body, the reply is a TFWCIpcView for every window, workspace by workspace from the top of the stack down
+    TFWC_IPC_BATCH = 2, //body is an array of TFWCIpcOp, the reply is a TFWCIpcStatus
+    TFWC_IPC_SUBSCRIBE = 3, //body is a uint32_t mask of TFWCIpcEventType replacing the previous one, the reply is a TFWCIpcStatus
+    TFWC_IPC_EVENT = 4, //only sent by the compositor, body is a TFWCIpcEvent
+};
+
+//a window, followed by titleLength bytes of title and appIdLength bytes of app id without terminators
+//the box is the window geometry in layout coordinates, so client side shadows dont count
+struct TFWCIpcView {
+    uint32_t id;
+    int32_t x, y, width, height;
+    uint32_t flags;
+    uint32_t workspace; //1 to 9, like the keybindings
+    uint16_t titleLength, appIdLength;
+};
+
+enum TFWCIpcViewFlags {
+    TFWC_IPC_VIEW_MAPPED = 1 << 0,
+    TFWC_IPC_VIEW_FOCUSED = 1 << 1,
+};
+
+//one operation of a batch, either all operations of a batch get applied or none of them
+enum TFWCIpcOpType {
+    TFWC_IPC_OP_MOVE = 1, //a and b are the new x and y of the window geometry
+    TFWC_IPC_OP_RESIZE = 2, //a and b are the new width and height
+    TFWC_IPC_OP_FOCUS = 3, //raises the window and gives it keyboard focus, showing its workspace if it wasnt
+    TFWC_IPC_OP_CLOSE = 4, //asks the window to close
+    TFWC_IPC_OP_WORKSPACE = 5, //a is the workspace from 1 to 9 to put the window on top of
+};
+
+struct TFWCIpcOp {
+    uint32_t op;
+    uint32_t id;
+    int32_t a, b;
+};
+
+enum TFWCIpcStatusCode {
+    TFWC_IPC_OK = 0,
+    TFWC_IPC_NO_WINDOW = 1, //index is the operation that named a window that doesnt exist
+    TFWC_IPC_BAD_OP = 2, //index is the operation that was invalid
+    TFWC_IPC_BAD_MESSAGE = 3, //the message type or length made no sense, the reply has the type of the message
+};
+
+struct TFWCIpcStatus {
+    uint32_t status;
+    uint32_t index;
+};
+
+enum TFWCIpcEventType {
+    TFWC_IPC_EVENT_MAP = 1 << 0,
+    TFWC_IPC_EVENT_UNMAP = 1 << 1,
+    TFWC_IPC_EVENT_FOCUS = 1 << 2,
+    TFWC_IPC_EVENT_GEOMETRY = 1 << 3,
+};
+
+struct TFWCIpcEvent {
+    uint32_t event;
+    uint32_t id;
+    int32_t x, y, width, height;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "TFWC-ipc.h"
+
+//command line client for the TFWC control socket
+//  TFWC-msg list
+//  TFWC-msg subscribe [map] [unmap] [focus] [geometry]
+//  TFWC-msg move ID X Y, resize ID W H, focus ID, close ID, workspace ID N ...
+//every operation on the command line goes into one batch, and with - they are read from stdin one per line instead
+//so a script can lay out hundreds of windows and they all change in the same frame
+
+static const char *opNames[] = { NULL, "move", "resize", "focus", "close", "workspace" };
+static const char *eventNames[] = { "map", "unmap", "focus", "geometry" };
+
+//helper functions
+
+static bool writeAll(int fd, const void *data, size_t length) {
+    while(length > 0) {
+        ssize_t written = write(fd, data, length);
+        if(written <= 0) return false;
+        data = (const char *)data + written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t length) {
+    while(length > 0) {
+        ssize_t got = read(fd, data, length);
+        if(got <= 0) return false;
+        data = (char *)data + got;
+        length -= got;
+    }
+    return true;
+}
+
+static bool sendMessage(int fd, uint32_t type, const void *body, uint32_t length) {
+    struct TFWCIpcHeader header = { .type = type, .length = length };
+    return writeAll(fd, &header, sizeof(header)) && writeAll(fd, body, length);
+}
+
+//reads the next message, the body has to be freed
+static char *readMessage(int fd, struct TFWCIpcHeader *header) {
+    if(!readAll(fd, header, sizeof(*header))) return NULL;
+    char *body = malloc(header->length + 1);
+    if(body == NULL || !readAll(fd, body, header->length)) {
+        free(body);
+        return NULL;
+    }
+    return body;
+}
+
+//waits for the reply to a request, a status tells what went wrong
+static bool readStatus(int fd, uint32_t type) {
+    struct TFWCIpcHeader header;
+    char *body = readMessage(fd, &header);
+    if(body == NULL || header.type != type || header.length != sizeof(struct TFWCIpcStatus)) {
+        fprintf(stderr, "bad reply from the compositor\n");
+        free(body);
+        return false;
+    }
+    struct TFWCIpcStatus status;
+    memcpy(&status, body, sizeof(status));
+    free(body);
+    if(status.status == TFWC_IPC_NO_WINDOW) fprintf(stderr, "operation %u: no such window\n", status.index + 1);
+    else if(status.status == TFWC_IPC_BAD_OP) fprintf(stderr, "operation %u: invalid\n", status.index + 1);
+    else if(status.status != TFWC_IPC_OK) fprintf(stderr, "the compositor didnt understand the request\n");
+    return status.status == TFWC_IPC_OK;
+}
+
+//parses one operation out of words, returns how many words it took or 0 if they werent one
+static int parseOp(char **words, int count, struct TFWCIpcOp *op) {
+    for(uint32_t i = 1; i < sizeof(opNames) / sizeof(opNames[0]); i++) {
+        if(count < 1 || strcmp(words[0], opNames[i]) != 0) continue;
+        int args = (i == TFWC_IPC_OP_MOVE || i == TFWC_IPC_OP_RESIZE) ? 3 : i == TFWC_IPC_OP_WORKSPACE ? 2 : 1;
+        if(count < 1 + args) return 0;
+        op->op = i;
+        op->id = strtoul(words[1], NULL, 10);
+        op->a = args >= 2 ? atoi(words[2]) : 0;
+        op->b = args == 3 ? atoi(words[3]) : 0;
+        return 1 + args;
+    }
+    return 0;
+}
+
+//commands
+
+static int list(int fd) {
+    if(!sendMessage(fd, TFWC_IPC_LIST, NULL, 0)) return 1;
+    struct TFWCIpcHeader header;
+    char *body = readMessage(fd, &header);
+    if(body == NULL || header.type != TFWC_IPC_LIST) return 1;
+    for(size_t offset = 0; offset + sizeof(struct TFWCIpcView) <= header.length;) {
+        struct TFWCIpcView view;
+        memcpy(&view, body + offset, sizeof(view));
+        offset += sizeof(view);
+        if(offset + view.titleLength + view.appIdLength > header.length) break;
+        printf("%u %u %d %d %d %d %s%s\t%.*s\t%.*s\n", view.id, view.workspace, view.x, view.y, view.width, view.height,
+            (view.flags & TFWC_IPC_VIEW_MAPPED) ? "mapped" : "unmapped", (view.flags & TFWC_IPC_VIEW_FOCUSED) ? ",focused" : "",
+            view.appIdLength, body + offset + view.titleLength, view.titleLength, body + offset);
+        offset += view.titleLength + view.appIdLength;
+    }
+    free(body);
+    return 0;
+}
+
+static int subscribe(int fd, char **words, int count) {
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i++) {
+        for(int j = 0; j < 4; j++) {
+            if(strcmp(words[i], eventNames[j]) == 0) mask |= 1u << j;
+        }
+    }
+    if(mask == 0) mask = TFWC_IPC_EVENT_MAP | TFWC_IPC_EVENT_UNMAP | TFWC_IPC_EVENT_FOCUS | TFWC_IPC_EVENT_GEOMETRY;
+    if(!sendMessage(fd, TFWC_IPC_SUBSCRIBE, &mask, sizeof(mask)) || !readStatus(fd, TFWC_IPC_SUBSCRIBE)) return 1;
+
+    //prints events until the compositor goes away, flushed every line so it can be piped into a script
+    while(true) {
+        struct TFWCIpcHeader header;
+        char *body = readMessage(fd, &header);
+        if(body == NULL) return 0;
+        struct TFWCIpcEvent event;
+        if(header.type == TFWC_IPC_EVENT && header.length == sizeof(event)) {
+            memcpy(&event, body, sizeof(event));
+            int bit = __builtin_ctz(event.event);
+            printf("%s %u %d %d %d %d\n", bit < 4 ? eventNames[bit] : "unknown", event.id, event.x, event.y, event.width, event.height);
+            fflush(stdout);
+        }
+        free(body);
+    }
+}
+
+static int batch(int fd, char **words, int count) {
+    size_t capacity = 64, ops = 0;
+    struct TFWCIpcOp *batch = malloc(capacity * sizeof(struct TFWCIpcOp));
+    char *line = NULL;
+    size_t lineSize = 0;
+    bool fromStdin = count == 1 && strcmp(words[0], "-") == 0;
+    while(true) {
+        //on stdin every line is one operation
+        char *lineWords[4];
+        if(fromStdin) {
+            if(getline(&line, &lineSize, stdin) < 0) break;
+            count = 0;
+            for(char *word = strtok(line, " \t\n"); word != NULL && count < 4; word = strtok(NULL, " \t\n")) lineWords[count++] = word;
+            if(count == 0) continue;
+            words = lineWords;
+        } else if(count == 0) {
+            break;
+        }
+        if(ops == capacity) batch = realloc(batch, (capacity *= 2) * sizeof(struct TFWCIpcOp));
+        int used = parseOp(words, count, &batch[ops]);
+        if(used == 0 || ops * sizeof(struct TFWCIpcOp) >= TFWC_IPC_MAX_MESSAGE) {
+            fprintf(stderr, used == 0 ? "invalid operation: %s\n" : "too many operations at %s\n", words[0]);
+            return 1;
+        }
+        ops++;
+        if(!fromStdin) {
+            words += used;
+            count -= used;
+        }
+    }
+    free(line);
+    bool ok = sendMessage(fd, TFWC_IPC_BATCH, batch, ops * sizeof(struct TFWCIpcOp)) && readStatus(fd, TFWC_IPC_BATCH);
+    free(batch);
+    return ok ? 0 : 1;
+}
+
+//main function
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s list | subscribe [map] [unmap] [focus] [geometry] | - | OPERATION...\n"
+            "operations: move ID X Y, resize ID W H, focus ID, close ID, workspace ID N\n", argv[0]);
+        return 1;
+    }
+    const char *path = getenv("TFWC_SOCKET");
+    if(path == NULL) {
+        fprintf(stderr, "TFWC_SOCKET isnt set\n");
+        return 1;
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("failed to connect to the compositor");
+        return 1;
+    }
+
+    int ret;
+    if(strcmp(argv[1], "list") == 0) ret = list(fd);
+    else if(strcmp(argv[1], "subscribe") == 0) ret = subscribe(fd, argv + 2, argc - 2);
+    else ret = batch(fd, argv + 1, argc - 1);
+    close(fd);
+    return ret;
+}
@@ -1,67 +1,364 @@
 #include <getopt.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/backend.h>
+#include <wlr/backend/headless.h>
 #include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_idle.h>
+#include <wlr/types/wlr_idle_inhibit_v1.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_viewporter.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/box.h>
+#include <wlr/util/edges.h>
 #include <wlr/util/log.h>
+#include <wlr/util/region.h>
 #include <xkbcommon/xkbcommon.h>
+#include "TFWC-ipc.h"
+#include "fractional-scale-v1-protocol.h"
 
 #define compositorKey WLR_MODIFIER_LOGO
 
+//modifiers that count for keybindings, caps lock and num lock get ignored
+#define keybindModifiers (WLR_MODIFIER_SHIFT | WLR_MODIFIER_CTRL | WLR_MODIFIER_ALT | WLR_MODIFIER_LOGO)
+
+//keybinding hash table size, has to be a power of two and well above the number of bindings
+#define keybindBuckets 64
+
+//how many keys that triggered a binding can be held down at once
+#define heldKeysMax 8
+
+//histograms have 16 buckets for every power of two nanoseconds, so percentiles are within about 6%
+#define histogramSubBuckets 16
+#define histogramBuckets (61 * histogramSubBuckets)
+
+//hit testing grid, 64x64 cells of 256 pixels before the cell hash wraps around
+#define gridCellSize 256
+#define gridBuckets 4096
+
+//milliseconds between frame callbacks for windows nobody can see
+#define hiddenFrameInterval 1000
+
+//milliseconds between telling idle protocol clients about input, so a fast mouse doesnt reset their timers on every event
+#define idleNotifyInterval 100
+
+//size of the pieces the tiled software compositor splits the damage into
+#define tileSize 128
+
+//window id hash table size for the control socket, has to be a power of two
+#define viewIdBuckets 256
+
+//milliseconds frames get held back for the windows of a control socket batch to take their new size
+#define ipcBatchTimeout 100
+
+//bytes a control socket client can have waiting to be sent before it gets dropped for not reading
+#define ipcMaxPending (8 << 20)
+
+//how many of the most recent trace events are kept
+#define traceEvents 65536
+
+//virtual workspaces, one for every number key
+#define workspaceCount 9
+
+enum TFWCCursorMode {
+    TFWC_CURSOR_PASSTHROUGH,
+    TFWC_CURSOR_MOVE,
+    TFWC_CURSOR_RESIZE,
+};
+
+struct TFWCHistogram {
+    uint64_t counts[histogramBuckets];
+    uint64_t total, max;
+};
+
+//a traced span of time, or a single point in time for instants
+struct TFWCTraceEvent {
+    uint64_t start, duration;
+    const char *name;
+    const char *argName; //NULL if the event has no argument
+    uint32_t arg;
+    uint16_t track; //0 is input and clients, every monitor gets its own
+    bool instant;
+};
+
+//trace recorder, off until TFWC_TRACE is set or SIGUSR2 turns it on, and then it costs a clock read and a store per event
+//building with -DTFWC_NO_TRACE turns every trace point into nothing
+#ifdef TFWC_NO_TRACE
+#define traceEnabled false
+#else
+static bool traceEnabled;
+#endif
+static struct TFWCTraceEvent traceBuffer[traceEvents];
+static uint64_t traceHead; //how many events were ever recorded, the next one goes into this modulo traceEvents
+
+//windows that arent being shown, kept out of the way of everything that only cares about what is on screen
+struct TFWCWorkspace {
+    struct wl_list views; //TFWCView.link, always empty for the active workspace since its windows are in TFWCServer.views
+    struct TFWCGridBucket *grid; //made when the first window goes onto the workspace
+};
+
 struct TFWCServer {
+    struct TFWCBench *bench; //only set in benchmark mode
     struct wl_display *display;
     struct wlr_backend *backend;
     struct wlr_renderer *renderer;
 
     struct wlr_xdg_shell *xdgShell;
     struct wl_listener newXdgWindow;
-    struct wl_list views;
+    struct wl_list views; //windows of the active workspace from the top of the stack down
+    struct TFWCGridBucket *grid; //hit testing grid of the active workspace
+    uint64_t stackCounter;
+    struct TFWCWorkspace workspaces[workspaceCount];
+    int activeWorkspace;
     struct wlr_allocator *allocator;
 
     struct wlr_cursor *cursor;
     struct wlr_xcursor_manager *cursorManager;
+    const char *cursorImage; //theme image currently on the cursor, NULL when a client set its own
     struct wl_listener cursorMotion;
     struct wl_listener cursorMotionAbsolute;
     struct wl_listener cursorButton;
     struct wl_listener cursorAxis;
     struct wl_listener cursorFrame;
+    struct wl_event_source *motionIdle; //hit test for the motion since it was last done, runs once the event loop has no more input to read
+    uint32_t motionTime;
+    double pointerOriginX, pointerOriginY; //layout position of the surface under the pointer, motion is sent relative to it until the next hit test
+    int pointerWidth, pointerHeight; //size of the surface under the pointer at the last hit test
+    enum TFWCCursorMode cursorMode;
     double grabedX, grabedY;
     struct TFWCView *grabbedView;
     struct wlr_box grabGeobox;
+    uint32_t resizeEdges;
 
     struct wlr_seat *seat;
     struct wl_listener newInput;
     struct wl_listener requestCursor;
     struct wl_listener requestSetSelection;
     struct wl_list keyboards;
+    const struct TFWCKeybind *keybinds[keybindBuckets];
+    struct xkb_context *xkbContext; //made when the first keyboard shows up
+    struct wl_list keymaps; //TFWCKeymap.link
 
     struct wlr_output_layout *outputLayout;
     struct wl_list outputs;
     struct wl_listener newOutput;
+    struct wl_listener layoutChange;
+    uint32_t outputBits; //bits handed out to monitors for the per window monitor sets
+    uint16_t traceTracks; //trace tracks handed out to monitors
+    struct wlr_presentation *presentation;
+    struct wl_event_source *hiddenFrameTimer;
+    struct TFWCTileCompositor *tiles; //only set when TFWC_RENDER_THREADS asks for the tiled software compositor
+    struct wl_list fractionalScales; //TFWCFractionalScale.link, only the ones whose surface still exists
+
+    //idle tracking, after idleTimeout milliseconds without input the monitors get turned off
+    struct wlr_idle *idle;
+    struct wlr_idle_inhibit_manager_v1 *idleInhibitManager;
+    struct wl_listener newIdleInhibitor;
+    int idleInhibitors;
+    int idleTimeout; //0 means never
+    struct wl_event_source *idleTimer;
+    struct timespec lastActivity;
+    struct timespec lastIdleNotify; //last time idle protocol clients were told about input
+    bool outputsOff;
+
+    struct wl_list clients; //TFWCClient.link, only clients that committed a buffer
+    struct wl_listener newSurface;
+    uint64_t clientMemoryLimit; //bytes of buffers a client can have on screen at once, 0 means no limit
+
+    //control socket, see TFWC-ipc.h
+    int ipcFd;
+    char ipcPath[108];
+    struct wl_event_source *ipcSource;
+    struct wl_list ipcClients; //TFWCIpcClient.link
+    int ipcSubscribers; //clients that asked for any events
+    uint32_t viewIdCounter;
+    struct TFWCView *viewIds[viewIdBuckets];
+    int batchPending; //windows of a batch that still have to commit their new size, frames are held back until then
+    struct wl_event_source *batchTimer;
+
+    //startup timing, in nanoseconds of the monotonic clock
+    uint64_t startNs, startupPhaseNs;
+    uint64_t firstFrameNs; //0 until the first frame was committed to any monitor
+};
+
+//state of the headless benchmark mode
+struct TFWCBench {
+    struct TFWCServer *server;
+    int clients, rate, duration;
+    const char *clientPath;
+    pid_t clientPid;
+    struct wl_event_source *inputTimer;
+    struct wl_event_source *phaseTimer;
+    bool measuring;
+    uint32_t step;
+    uint64_t frames;
+    struct TFWCHistogram frameTime, hitTest, commitToPresent;
+    bool failed; //the results didnt measure what they should, so make bench fails
+};
+
+//the box and stack position are copied into the bucket so lookups dont have to touch the windows themselves
+struct TFWCGridEntry {
+    struct wlr_box box;
+    uint64_t stackOrder;
+    struct TFWCView *view;
+};
+
+//one thing the tiled compositor draws, either an image or a solid fill when data is NULL
+struct TFWCTileJob {
+    pixman_region32_t region; //part of the frame this job covers
+    pixman_color_t color;
+    uint32_t *data;
+    bool staged; //the pixels are a copy in the staging buffer at offset, data gets pointed there once nothing is added anymore
+    size_t offset;
+    pixman_format_code_t format;
+    int width, height, stride;
+    int x, y; //where the image goes in the frame
+};
+
+//worker pool of the tiled software compositor, the workers only ever touch pixels and pixman images they made themselves
+struct TFWCTileCompositor {
+    int threads; //including the main thread
+    pthread_t *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, finished;
+    uint64_t generation; //goes up for every frame handed to the workers
+    int running; //workers that havent finished the current frame
+    bool quit;
+
+    //the frame being composited
+    uint32_t *data;
+    pixman_format_code_t format;
+    int width, height, stride;
+    struct TFWCTileJob *jobs;
+    int jobCount, jobCapacity;
+    pixman_box32_t *tiles;
+    int tileCount, tileCapacity;
+    int nextTile;
+    char *staging; //copies of the client pixels of the frame, kept around at the biggest size a frame needed
+    size_t stagingSize, stagingUsed;
+};
+
+struct TFWCGridBucket {
+    struct TFWCGridEntry *entries;
+    int count, capacity;
+};
+
+//counters and histograms of a monitor, dumped on SIGUSR1
+struct TFWCOutputStats {
+    uint64_t framesComposited, framesScannedOut;
+    uint64_t framesSkipped; //frame events where nothing had changed
+    uint64_t framesDropped; //frames that failed to attach a buffer or commit
+    uint64_t framesDelayed, deadlinesMissed; //frames that waited for the render deadline, and ones that still missed their vblank
+    uint64_t framesHeld; //frames held back while a control socket batch was waiting for windows to resize
+    uint64_t surfacesDrawn, texturesMissing;
+    uint64_t surfacesScaled; //surfaces drawn with their buffer resampled instead of 1:1
+    struct TFWCHistogram renderTime, commitTime, surfacesPerFrame;
 };
 
 struct TFWCOutput {
     struct wl_list link;
     struct TFWCServer *server;
     struct wlr_output *wlrOutput;
+    struct wlr_output_damage *damage;
     struct wl_listener frame;
+    struct wl_listener destroy;
+    struct wl_listener present;
+    uint32_t bit; //this monitors bit in the monitor sets of windows, never 0 since only 32 monitors are used
+    uint16_t traceTrack;
+    struct wlr_box layoutBox; //where the monitor is in the layout, cached so rendering doesnt have to ask the layout
+    bool scannedOut; //whether the last frame was a client buffer shown directly
+    struct TFWCView *scanoutView; //window whose buffer was last scanned out, only compared against and cleared when it goes away
+    struct TFWCOutputStats stats;
+
+    //render deadline scheduling
+    int maxRenderTime; //milliseconds to keep free for rendering before vblank, 0 renders right away and -1 tunes it from measured frames
+    struct wl_event_source *renderTimer;
+    bool renderPending;
+    uint64_t lastPresentNs, refreshNs;
+    uint64_t aimedVblankNs; //vblank the delayed frame being rendered is aimed at, 0 if it isnt delayed
+    uint64_t targetVblankNs; //vblank the last committed frame was aimed at, 0 if there wasnt one
+    uint64_t marginNs; //safety margin on top of the measured frame times, grows when a deadline is missed
+    uint64_t recentFrameNs[32];
+    int recentFrameIndex;
+};
+
+//buffer memory a client has committed to its surfaces, dumped on SIGUSR1
+struct TFWCClient {
+    struct wl_list link;
+    struct wl_client *client;
+    struct wl_listener destroy;
+    uint64_t bufferBytes, peakBytes;
+    uint32_t buffers;
+    bool overLimit;
+};
+
+//every wl_surface a client makes, whatever its role, since any of them can hold a buffer
+struct TFWCSurface {
+    struct TFWCServer *server;
+    struct wlr_surface *surface;
+    uint64_t bufferBytes; //what the current buffer counts towards the clients memory
+    struct wl_listener commit;
+    struct wl_listener destroy;
+};
+
+//a connection to the control socket
+struct TFWCIpcClient {
+    struct wl_list link;
+    struct TFWCServer *server;
+    int fd;
+    struct wl_event_source *source;
+    char *in, *out;
+    size_t inLength, inSize, outLength, outSize;
+    uint32_t events; //TFWCIpcEventType bits it subscribed to
+    bool dropped; //gets destroyed the next time its socket is looked at
+};
+
+//a fractional scale object a client made for one of its surfaces
+struct TFWCFractionalScale {
+    struct wl_list link;
+    struct TFWCServer *server;
+    struct wl_resource *resource;
+    struct wlr_surface *surface; //NULL once the surface is gone
+    struct wl_listener surfaceDestroy;
+    uint32_t scale; //preferred scale last sent in 120ths, 0 before the first
+};
+
+struct TFWCIdleInhibitor {
+    struct TFWCServer *server;
+    struct wl_listener destroy;
 };
 
 struct TFWCKeyboard {
@@ -70,6 +367,25 @@ struct TFWCKeyboard {
     struct wlr_input_device *device;
     struct wl_listener modifiers;
     struct wl_listener key;
+    //keys that triggered a binding, their release goes to the binding instead of the program
+    uint32_t heldKeycodes[heldKeysMax];
+    const struct TFWCKeybind *heldBinds[heldKeysMax];
+    int heldCount;
+};
+
+//a compiled keymap and the rule names it was compiled from, NULL names are the defaults
+struct TFWCKeymap {
+    struct wl_list link;
+    char *rules, *model, *layout, *variant, *options;
+    struct xkb_keymap *keymap;
+};
+
+//a keybinding, the action gets called on both press and release of the key
+struct TFWCKeybind {
+    uint32_t modifiers;
+    xkb_keysym_t sym;
+    void (*action)(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed);
+    char *const *argv; //program to start for spawn bindings
 };
 
 struct TFWCView {
@@ -81,17 +397,322 @@ struct TFWCView {
     struct wl_listener destroy;
     struct wl_listener requestMove;
     struct wl_listener requestResize;
+    struct wl_listener commit;
+    struct wl_listener newPopup;
+    struct wl_listener newSubsurface;
+    struct wl_listener ackConfigure;
     bool mapped;
+    int workspace;
     int x, y;
+    struct wlr_box extents; //layout space box around the window and all its popups, as last damaged
+    struct wlr_box gridBox; //the extents the window is indexed under in the hit testing grid, empty if it isnt
+    uint64_t stackOrder; //higher means closer to the top, only ever grows so raising a window is cheap
+    uint32_t outputs; //bits of the monitors the extents touch
+    uint32_t occludedOutputs; //bits of the monitors where opaque windows above cover it completely, as of their last frame
+    uint32_t resizeSerial; //serial of the size configure the client hasnt acked yet, 0 if there is none
+    bool resizeQueued; //a newer size is waiting for the client to catch up
+    int queuedWidth, queuedHeight;
+    uint32_t anchorEdges; //left or top edges of a resize, sizes the client commits keep the opposite edges where they were
+    int anchorRight, anchorBottom; //layout position of those opposite edges
+    uint32_t id; //what the control socket calls the window
+    struct TFWCView *idNext; //next window in the same id hash bucket
+    struct wlr_box ipcBox; //geometry last sent to control socket subscribers
+    bool batchPending; //a control socket batch is waiting for the window to take its new size
+    bool batchMove; //the batch also moves it, which happens together with the resize
+    int batchX, batchY;
+    pixman_region32_t visible; //damaged part of the window not covered by opaque windows above, only valid while rendering a monitor
+    struct timespec benchCommitTime; //oldest commit that hasnt been presented yet, only tracked in benchmark mode
+    uint32_t benchCommitSeq;
+    bool benchCommitPending;
+    struct wl_list children; //TFWCChild.link
+};
+
+//a popup or subsurface of a window, tracked so its commits damage the right part of the screen
+struct TFWCChild {
+    struct wl_list link;
+    struct TFWCServer *server;
+    struct TFWCView *view; //NULL once the window is gone, subsurfaces can outlive it
+    struct wlr_surface *surface;
+    struct wl_listener commit;
+    struct wl_listener unmap;
+    struct wl_listener newPopup;
+    struct wl_listener newSubsurface;
+    struct wl_listener destroy;
 };
 
 struct renderData {
 	struct wlr_output *output;
 	struct wlr_renderer *renderer;
 	struct TFWCView *view;
-	struct timespec *when;
+	int ox, oy; //where the window is relative to the monitor
+	pixman_region32_t *damage;
+	struct TFWCOutputStats *stats;
+	int surfacesDrawn;
+};
+
+struct opaqueData {
+    float scale;
+    int ox, oy; //where the window is relative to the monitor, or in the layout
+    pixman_region32_t *opaque;
+};
+
+struct tileData {
+    struct TFWCOutput *output;
+    int ox, oy; //where the window is relative to the monitor
+    pixman_region32_t *visible;
+    bool failed; //a surface the tiled compositor cant draw was found
+    int surfacesDrawn;
+};
+
+struct damageData {
+    struct TFWCOutput *output;
+    struct TFWCView *view;
+    struct wlr_surface *onlySurface;
+    bool whole;
 };
 
+//statistics
+
+static uint64_t timespecNs(struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+//nanoseconds since some point in time
+static uint64_t nsSince(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecNs(&now) - timespecNs(start);
+}
+
+//records a duration in a histogram, this is just a few instructions so it can be left on
+static void histogramRecord(struct TFWCHistogram *histogram, uint64_t ns) {
+    int index = ns;
+    if(ns >= histogramSubBuckets) {
+        int log = 63 - __builtin_clzll(ns);
+        index = (log - 3) * histogramSubBuckets + ((ns >> (log - 4)) & (histogramSubBuckets - 1));
+    }
+    histogram->counts[index]++;
+    histogram->total++;
+    if(ns > histogram->max) histogram->max = ns;
+}
+
+//returns the middle of the bucket the given fraction of recorded durations falls into
+static uint64_t histogramPercentile(struct TFWCHistogram *histogram, double fraction) {
+    if(histogram->total == 0) return 0;
+    uint64_t target = ceil(histogram->total * fraction), seen = 0;
+    for(int i = 0; i < histogramBuckets; i++) {
+        seen += histogram->counts[i];
+        if(seen < target || seen == 0) continue;
+        if(i < histogramSubBuckets) return i;
+        int shift = i / histogramSubBuckets - 1;
+        uint64_t low = (uint64_t)(histogramSubBuckets + i % histogramSubBuckets) << shift;
+        uint64_t mid = low + ((1ull << shift) >> 1);
+        return mid < histogram->max ? mid : histogram->max;
+    }
+    return histogram->max;
+}
+
+//prints a histogram as a json object, in microseconds or nanoseconds
+static void histogramPrintJson(FILE *file, const char *name, struct TFWCHistogram *histogram, bool micro) {
+    double divisor = micro ? 1000.0 : 1.0;
+    fprintf(file, "\"%s\": {\"count\": %" PRIu64 ", \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+        name, histogram->total,
+        histogramPercentile(histogram, 0.5) / divisor,
+        histogramPercentile(histogram, 0.9) / divisor,
+        histogramPercentile(histogram, 0.99) / divisor,
+        histogram->max / divisor);
+}
+
+//tracing
+
+//timestamp a span starts at, 0 when not recording so the matching traceEnd does nothing
+static inline uint64_t traceBegin(void) {
+    if(!traceEnabled) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecNs(&now);
+}
+
+//claiming a slot is a single atomic add, so recording never takes a lock and the oldest events just get overwritten
+static void traceRecord(const char *name, uint16_t track, uint64_t start, uint64_t duration, bool instant, const char *argName, uint32_t arg) {
+    uint64_t slot = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED) % traceEvents;
+    traceBuffer[slot] = (struct TFWCTraceEvent){
+        .start = start,
+        .duration = duration,
+        .name = name,
+        .argName = argName,
+        .arg = arg,
+        .track = track,
+        .instant = instant,
+    };
+}
+
+//ends a span started with traceBegin, spans only get recorded once they ended so the ring never holds half of one
+static inline void traceEnd(uint64_t start, const char *name, uint16_t track, const char *argName, uint32_t arg) {
+    if(start == 0) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    traceRecord(name, track, start, timespecNs(&now) - start, false, argName, arg);
+}
+
+static inline void traceInstant(const char *name, uint16_t track, uint64_t when, const char *argName, uint32_t arg) {
+    if(!traceEnabled) return;
+    if(when == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        when = timespecNs(&now);
+    }
+    traceRecord(name, track, when, 0, true, argName, arg);
+}
+
+//writes the ring buffer as chrome trace json, oldest event first, every monitor gets its own track
+static void traceWrite(struct TFWCServer *server) {
+    char defaultPath[64];
+    const char *path = getenv("TFWC_TRACE_FILE");
+    if(path == NULL) {
+        snprintf(defaultPath, sizeof(defaultPath), "/tmp/tfwc-trace-%d.json", (int)getpid());
+        path = defaultPath;
+    }
+    FILE *file = fopen(path, "w");
+    if(file == NULL) {
+        wlr_log_errno(WLR_ERROR, "failed to open trace file %s", path);
+        return;
+    }
+    int pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, \"args\": {\"name\": \"input and clients\"}}", pid);
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            pid, output->traceTrack, output->wlrOutput->name);
+    }
+
+    uint64_t head = __atomic_load_n(&traceHead, __ATOMIC_RELAXED);
+    uint64_t first = head > traceEvents ? head - traceEvents : 0;
+    for(uint64_t i = first; i < head; i++) {
+        struct TFWCTraceEvent *event = &traceBuffer[i % traceEvents];
+        fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"%s\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f",
+            event->name, event->instant ? "i\", \"s\": \"t" : "X", pid, event->track, event->start / 1000.0);
+        if(!event->instant) fprintf(file, ", \"dur\": %.3f", event->duration / 1000.0);
+        if(event->argName) fprintf(file, ", \"args\": {\"%s\": %" PRIu32 "}", event->argName, event->arg);
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    wlr_log(WLR_INFO, "wrote %" PRIu64 " trace events to %s", head - first, path);
+}
+
+//the first SIGUSR2 starts recording if TFWC_TRACE didnt already, every later one writes out what was recorded
+static int traceSignal(int signalNumber, void *data) {
+    if(traceEnabled) {
+        traceWrite(data);
+        return 0;
+    }
+#ifdef TFWC_NO_TRACE
+    wlr_log(WLR_INFO, "tracing was left out of this build");
+#else
+    traceEnabled = true;
+    wlr_log(WLR_INFO, "tracing started");
+#endif
+    return 0;
+}
+
+//startup timing
+
+//marks the end of a startup phase and returns when that was, every phase gets logged and traced so a slow one stands out
+static uint64_t startupPhase(struct TFWCServer *server, const char *name) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = timespecNs(&now);
+    if(traceEnabled) traceRecord(name, 0, server->startupPhaseNs, ns - server->startupPhaseNs, false, NULL, 0);
+    wlr_log(WLR_DEBUG, "startup: %s took %.2fms", name, (ns - server->startupPhaseNs) / 1e6);
+    server->startupPhaseNs = ns;
+    return ns;
+}
+
+//client memory accounting
+
+static void clientDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCClient *client = wl_container_of(listener, client, destroy);
+    wl_list_remove(&client->destroy.link);
+    wl_list_remove(&client->link);
+    free(client);
+}
+
+//finds the accounting of a client, the destroy listener doubles as the lookup so nothing has to be searched
+//this runs out before the surfaces of a disconnecting client get destroyed, those just dont find anything anymore
+static struct TFWCClient *findClient(struct TFWCServer *server, struct wl_client *wlClient, bool create) {
+    struct wl_listener *listener = wl_client_get_destroy_listener(wlClient, clientDestroy);
+    if(listener != NULL) {
+        struct TFWCClient *client = wl_container_of(listener, client, destroy);
+        return client;
+    }
+    if(!create) return NULL;
+    struct TFWCClient *client = calloc(1, sizeof(struct TFWCClient));
+    client->client = wlClient;
+    client->destroy.notify = clientDestroy;
+    wl_client_add_destroy_listener(wlClient, &client->destroy);
+    wl_list_insert(&server->clients, &client->link);
+    return client;
+}
+
+//memory the current buffer of a surface takes, its texture or shm mapping is about 4 bytes a pixel either way
+static uint64_t surfaceBufferBytes(struct wlr_surface *surface) {
+    if(surface->buffer == NULL) return 0;
+    return (uint64_t)surface->buffer->base.width * surface->buffer->base.height * 4;
+}
+
+//moves what a surface counts towards its client from the old to the new size of its buffer
+//a client that goes over the limit gets disconnected, that frees everything it had and it cant grow any further
+static void accountSurface(struct TFWCServer *server, struct wlr_surface *surface, uint64_t *counted, uint64_t bytes) {
+    if(bytes == *counted) return;
+    struct TFWCClient *client = findClient(server, wl_resource_get_client(surface->resource), bytes > 0);
+    if(client == NULL) {
+        *counted = bytes;
+        return;
+    }
+    client->bufferBytes += bytes - *counted;
+    client->buffers += (bytes > 0) - (*counted > 0);
+    if(client->bufferBytes > client->peakBytes) client->peakBytes = client->bufferBytes;
+    *counted = bytes;
+
+    if(server->clientMemoryLimit > 0 && client->bufferBytes > server->clientMemoryLimit && !client->overLimit) {
+        client->overLimit = true;
+        pid_t pid;
+        wl_client_get_credentials(client->client, &pid, NULL, NULL);
+        wlr_log(WLR_ERROR, "client %d has %" PRIu64 " bytes of buffers, over the limit of %" PRIu64 ", disconnecting it",
+            (int)pid, client->bufferBytes, server->clientMemoryLimit);
+        wl_client_post_no_memory(client->client);
+    }
+}
+
+//called when any surface commits, cursors and drag icons have buffers too
+static void surfaceCommit(struct wl_listener *listener, void *data) {
+    struct TFWCSurface *tsurface = wl_container_of(listener, tsurface, commit);
+    accountSurface(tsurface->server, tsurface->surface, &tsurface->bufferBytes, surfaceBufferBytes(tsurface->surface));
+}
+
+static void surfaceDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCSurface *tsurface = wl_container_of(listener, tsurface, destroy);
+    accountSurface(tsurface->server, tsurface->surface, &tsurface->bufferBytes, 0);
+    wl_list_remove(&tsurface->commit.link);
+    wl_list_remove(&tsurface->destroy.link);
+    free(tsurface);
+}
+
+//every surface gets accounted no matter what it is used for, so surfaces without a role cant get around the limit
+static void serverNewSurface(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, newSurface);
+    struct wlr_surface *surface = data;
+    struct TFWCSurface *tsurface = calloc(1, sizeof(struct TFWCSurface));
+    tsurface->server = server;
+    tsurface->surface = surface;
+    tsurface->commit.notify = surfaceCommit;
+    wl_signal_add(&surface->events.commit, &tsurface->commit);
+    tsurface->destroy.notify = surfaceDestroy;
+    wl_signal_add(&surface->events.destroy, &tsurface->destroy);
+}
+
 //helper functions
 
 //function to check if a window is at a coordinate
@@ -110,254 +731,2509 @@ static bool view_at(struct TFWCView *view, double lx, double ly, struct wlr_surf
     return false;
 }
 
+//hit testing grid
+
+//rounds down instead of towards zero, so cells left and above of the origin dont overlap
+static int gridCell(int coord) {
+    return coord >= 0 ? coord / gridCellSize : (coord - gridCellSize + 1) / gridCellSize;
+}
+
+static struct TFWCGridBucket *gridBucket(struct TFWCGridBucket *grid, int cx, int cy) {
+    uint32_t hash = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+    return &grid[hash & (gridBuckets - 1)];
+}
+
+//every workspace has its own grid, so hit testing never even sees the windows that arent shown
+static struct TFWCGridBucket *workspaceGrid(struct TFWCServer *server, int workspace) {
+    struct TFWCWorkspace *ws = &server->workspaces[workspace];
+    if(ws->grid == NULL) ws->grid = calloc(gridBuckets, sizeof(struct TFWCGridBucket));
+    return ws->grid;
+}
+
+//takes a window out of every cell its indexed under
+static void gridRemoveView(struct TFWCView *view) {
+    struct wlr_box *box = &view->gridBox;
+    if(wlr_box_empty(box)) return;
+    struct TFWCGridBucket *grid = workspaceGrid(view->server, view->workspace);
+    for(int cy = gridCell(box->y); cy <= gridCell(box->y + box->height - 1); cy++) {
+        for(int cx = gridCell(box->x); cx <= gridCell(box->x + box->width - 1); cx++) {
+            struct TFWCGridBucket *bucket = gridBucket(grid, cx, cy);
+            for(int i = 0; i < bucket->count; i++) {
+                if(bucket->entries[i].view != view) continue;
+                memmove(&bucket->entries[i], &bucket->entries[i + 1], (bucket->count - i - 1) * sizeof(struct TFWCGridEntry));
+                bucket->count--;
+                break;
+            }
+        }
+    }
+    *box = (struct wlr_box){ 0 };
+}
+
+//indexes a window under every cell its box touches, buckets are kept sorted from the top of the stack down
+static void gridInsertView(struct TFWCView *view, struct wlr_box *box) {
+    if(wlr_box_empty(box)) return;
+    struct TFWCGridBucket *grid = workspaceGrid(view->server, view->workspace);
+    for(int cy = gridCell(box->y); cy <= gridCell(box->y + box->height - 1); cy++) {
+        for(int cx = gridCell(box->x); cx <= gridCell(box->x + box->width - 1); cx++) {
+            struct TFWCGridBucket *bucket = gridBucket(grid, cx, cy);
+            //cells far apart can hash to the same bucket
+            int pos = bucket->count;
+            bool present = false;
+            for(int i = 0; i < bucket->count && !present; i++) {
+                present = bucket->entries[i].view == view;
+                if(pos == bucket->count && bucket->entries[i].stackOrder < view->stackOrder) pos = i;
+            }
+            if(present) continue;
+            if(bucket->count == bucket->capacity) {
+                bucket->capacity = bucket->capacity ? bucket->capacity * 2 : 8;
+                bucket->entries = realloc(bucket->entries, bucket->capacity * sizeof(struct TFWCGridEntry));
+            }
+            memmove(&bucket->entries[pos + 1], &bucket->entries[pos], (bucket->count - pos) * sizeof(struct TFWCGridEntry));
+            bucket->entries[pos] = (struct TFWCGridEntry){
+                .box = *box,
+                .stackOrder = view->stackOrder,
+                .view = view,
+            };
+            bucket->count++;
+        }
+    }
+    view->gridBox = *box;
+}
+
+//reindexes a window after it was mapped, moved or resized
+static void gridUpdateView(struct TFWCView *view) {
+    if(!view->mapped) {
+        gridRemoveView(view);
+        return;
+    }
+    if(memcmp(&view->gridBox, &view->extents, sizeof(struct wlr_box)) == 0) return;
+    gridRemoveView(view);
+    gridInsertView(view, &view->extents);
+}
+
+//moves a window to the front of every cell its indexed under after it was raised to the top
+static void gridRaiseView(struct TFWCView *view) {
+    struct wlr_box *box = &view->gridBox;
+    if(wlr_box_empty(box)) return;
+    struct TFWCGridBucket *grid = workspaceGrid(view->server, view->workspace);
+    for(int cy = gridCell(box->y); cy <= gridCell(box->y + box->height - 1); cy++) {
+        for(int cx = gridCell(box->x); cx <= gridCell(box->x + box->width - 1); cx++) {
+            struct TFWCGridBucket *bucket = gridBucket(grid, cx, cy);
+            for(int i = 0; i < bucket->count; i++) {
+                if(bucket->entries[i].view != view) continue;
+                struct TFWCGridEntry entry = bucket->entries[i];
+                entry.stackOrder = view->stackOrder;
+                memmove(&bucket->entries[1], &bucket->entries[0], i * sizeof(struct TFWCGridEntry));
+                bucket->entries[0] = entry;
+                break;
+            }
+        }
+    }
+}
+
+//finds the topmost window below the given stack position whose box contains a point, only windows in the cell of the point are looked at
+static struct TFWCView *gridViewAt(struct TFWCServer *server, double lx, double ly, uint64_t below) {
+    struct TFWCGridBucket *bucket = gridBucket(server->grid, gridCell(floor(lx)), gridCell(floor(ly)));
+    for(int i = 0; i < bucket->count; i++) {
+        struct TFWCGridEntry *entry = &bucket->entries[i];
+        if(entry->stackOrder >= below) continue;
+        if(lx < entry->box.x || lx >= entry->box.x + entry->box.width) continue;
+        if(ly < entry->box.y || ly >= entry->box.y + entry->box.height) continue;
+        return entry->view;
+    }
+    return NULL;
+}
+
 //function to check what window is at some coordinate
 static struct TFWCView *desktop_view_at(
     struct TFWCServer *server, double lx, double ly,
     struct wlr_surface **surface, double *sx, double *sy) {
-    struct TFWCView *view;
-    wl_list_for_each(view, &server->views, link) {
+    struct timespec start;
+    if(server->bench) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    //the grid only knows the boxes, so candidates still get the exact per surface test from the top down
+    struct TFWCView *view = gridViewAt(server, lx, ly, UINT64_MAX);
+    while(view != NULL) {
         if (view_at(view, lx, ly, surface, sx, sy)) {
-            return view;
+            break;
         }
+        view = gridViewAt(server, lx, ly, view->stackOrder);
     }
-    return NULL;
+
+    if(server->bench) histogramRecord(&server->bench->hitTest, nsSince(&start));
+    return view;
 }
 
-//setter for window position
-void setWindowPosition(struct TFWCView *view, int x, int y) {
-    view->x = x;
-    view->y = y;
+//monitor sets of windows
+
+//whether a window touches a monitor
+static bool viewOnOutput(struct TFWCView *view, struct TFWCOutput *output) {
+    return view->outputs & output->bit;
 }
 
-//setter for window size
-void setWindowSize(struct TFWCView *view, int w, int h) {
-    struct wlr_box geo_box;
-    wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
-    wlr_xdg_toplevel_set_size(view->xdgSurface, w, h);
+//whether a window is mapped and on the workspace being shown, the others dont get to damage the screen
+static bool viewShown(struct TFWCView *view) {
+    return view->mapped && view->workspace == view->server->activeWorkspace;
 }
 
-//keyboard stuff
+//whether nobody can see a window, because its unmapped, on another workspace, off screen or covered on every monitor its on
+static bool viewHidden(struct TFWCView *view) {
+    return !viewShown(view) || (view->outputs & ~view->occludedOutputs) == 0;
+}
 
-//keyboard modifier key event handling
-static void keyboard_handle_modifiers(struct wl_listener *listener, void *data) {
-    struct TFWCKeyboard *keyboard = wl_container_of(listener, keyboard, modifiers);
-    wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
-    wlr_seat_keyboard_notify_modifiers(keyboard->server->seat, &keyboard->device->keyboard->modifiers);
+//the list a workspaces windows are in, the active ones are in the servers list so everything drawing the screen only walks those
+static struct wl_list *workspaceViews(struct TFWCServer *server, int workspace) {
+    return workspace == server->activeWorkspace ? &server->views : &server->workspaces[workspace].views;
 }
 
-//keyboard key press event handeler
-static void keyboard_handle_key(struct wl_listener *listener, void *data) {
-    struct TFWCKeyboard *keyboard = wl_container_of(listener, keyboard, key);
-    struct TFWCServer *server = keyboard->server;
-    struct wlr_event_keyboard_key *event = data;
-    struct wlr_seat *seat = server->seat;
+static void surfaceEnter(struct wlr_surface *surface, int sx, int sy, void *data) {
+    wlr_surface_send_enter(surface, data);
+}
 
-    //handle keycode stuff
-    uint32_t keycode = event->keycode + 8;
-    const xkb_keysym_t *syms;
-    int nsyms = xkb_state_key_get_syms(keyboard->device->keyboard->xkb_state, keycode, &syms);
-    uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->device->keyboard);
+static void surfaceLeave(struct wlr_surface *surface, int sx, int sy, void *data) {
+    wlr_surface_send_leave(surface, data);
+}
 
-    //all events get passed to the focused program if your key isnt held down for compositor keybinds
-    if(modifiers & compositorKey) {
-        if (fork() == 0) {
-	    execl("/bin/sh", "/bin/sh", "-c", "st", (void *)NULL);
-        }
-    } else {
-        //all other keypresses get sent to the current program
-        wlr_seat_set_keyboard(seat, keyboard->device);
-        wlr_seat_keyboard_notify_key(seat, event->time_msec, event->keycode, event->state);
+//recalculates which monitors a window is on from its extents, returns whether that changed
+//its surfaces get told which monitors they entered and left, so clients can pick the buffer scale of the monitors theyre on
+static bool updateViewOutputs(struct TFWCView *view) {
+    uint32_t outputs = 0;
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &view->server->outputs, link) {
+        struct wlr_box intersection;
+        if(wlr_box_intersection(&intersection, &view->extents, &output->layoutBox)) outputs |= output->bit;
     }
+    uint32_t changed = outputs ^ view->outputs;
+    view->outputs = outputs;
+    if(changed == 0) return false;
+    wl_list_for_each(output, &view->server->outputs, link) {
+        if(!(changed & output->bit)) continue;
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, (outputs & output->bit) ? surfaceEnter : surfaceLeave, output->wlrOutput);
+    }
+    return true;
 }
 
-//setting window focus for keyboard inputs
-static void focus_view(struct TFWCView *view, struct wlr_surface *surface) {
-    if(view == NULL) return;
-    struct TFWCServer *server = view->server;
-    struct wlr_seat *seat = server->seat;
-    struct wlr_surface *prev_surface = seat->keyboard_state.focused_surface;
-    if (prev_surface == surface) return;
+//fractional scaling
+
+//the window a surface belongs to, popups are followed up to the window that opened them
+static struct TFWCView *surfaceView(struct wlr_surface *surface) {
+    while(true) {
+        surface = wlr_surface_get_root_surface(surface);
+        if(!wlr_surface_is_xdg_surface(surface)) return NULL;
+        struct wlr_xdg_surface *xdgSurface = wlr_xdg_surface_from_wlr_surface(surface);
+        if(xdgSurface->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL) return xdgSurface->data;
+        if(xdgSurface->role != WLR_XDG_SURFACE_ROLE_POPUP || xdgSurface->popup->parent == NULL) return NULL;
+        surface = xdgSurface->popup->parent;
+    }
+}
 
-    //deactivate previous window
-    if (prev_surface) {
-        struct wlr_xdg_surface *previous = wlr_xdg_surface_from_wlr_surface(seat->keyboard_state.focused_surface);
-        wlr_xdg_toplevel_set_activated(previous, false);
+//the scale a surface should draw at, the highest of the monitors its window is on so it is sharp on all of them
+//a window that isnt on any monitor yet gets the highest scale there is
+static float preferredScale(struct TFWCServer *server, struct wlr_surface *surface) {
+    struct TFWCView *view = surfaceView(surface);
+    float scale = 0, highest = 1;
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        float outputScale = output->wlrOutput->scale;
+        if(view != NULL && (view->outputs & output->bit) && outputScale > scale) scale = outputScale;
+        if(outputScale > highest) highest = outputScale;
     }
-    struct wlr_keyboard *keyboard = wlr_seat_get_keyboard(seat);
+    return scale > 0 ? scale : highest;
+}
 
-    //move the window to the top
-    wl_list_remove(&view->link);
-    wl_list_insert(&server->views, &view->link);
+//tells the client the scale if it changed, in the 120ths the protocol uses
+static void sendFractionalScale(struct TFWCFractionalScale *fractionalScale) {
+    uint32_t scale = round(preferredScale(fractionalScale->server, fractionalScale->surface) * 120);
+    if(scale == fractionalScale->scale) return;
+    fractionalScale->scale = scale;
+    wp_fractional_scale_v1_send_preferred_scale(fractionalScale->resource, scale);
+}
+
+//called when windows moved between monitors or monitors changed their scale
+static void updateFractionalScales(struct TFWCServer *server) {
+    struct TFWCFractionalScale *fractionalScale;
+    wl_list_for_each(fractionalScale, &server->fractionalScales, link) sendFractionalScale(fractionalScale);
+}
+
+//the object stays around until the client destroys it, but it doesnt get any more events
+static void fractionalScaleSurfaceDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCFractionalScale *fractionalScale = wl_container_of(listener, fractionalScale, surfaceDestroy);
+    wl_list_remove(&fractionalScale->link);
+    wl_list_init(&fractionalScale->link);
+    wl_list_remove(&fractionalScale->surfaceDestroy.link);
+    wl_list_init(&fractionalScale->surfaceDestroy.link);
+    fractionalScale->surface = NULL;
+}
+
+static void fractionalScaleResourceDestroy(struct wl_resource *resource) {
+    struct TFWCFractionalScale *fractionalScale = wl_resource_get_user_data(resource);
+    wl_list_remove(&fractionalScale->link);
+    wl_list_remove(&fractionalScale->surfaceDestroy.link);
+    free(fractionalScale);
+}
+
+static void destroyResource(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wp_fractional_scale_v1_interface fractionalScaleImpl = {
+    .destroy = destroyResource,
+};
+
+static void fractionalScaleManagerGet(struct wl_client *client, struct wl_resource *manager, uint32_t id, struct wl_resource *surfaceResource) {
+    struct TFWCServer *server = wl_resource_get_user_data(manager);
+    struct wlr_surface *surface = wlr_surface_from_resource(surfaceResource);
+    struct TFWCFractionalScale *fractionalScale;
+    wl_list_for_each(fractionalScale, &server->fractionalScales, link) {
+        if(fractionalScale->surface != surface) continue;
+        wl_resource_post_error(manager, WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_FRACTIONAL_SCALE_EXISTS, "surface already has a fractional scale object");
+        return;
+    }
+
+    fractionalScale = calloc(1, sizeof(struct TFWCFractionalScale));
+    if(fractionalScale == NULL) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    fractionalScale->resource = wl_resource_create(client, &wp_fractional_scale_v1_interface, wl_resource_get_version(manager), id);
+    if(fractionalScale->resource == NULL) {
+        free(fractionalScale);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(fractionalScale->resource, &fractionalScaleImpl, fractionalScale, fractionalScaleResourceDestroy);
+    fractionalScale->server = server;
+    fractionalScale->surface = surface;
+    fractionalScale->surfaceDestroy.notify = fractionalScaleSurfaceDestroy;
+    wl_signal_add(&surface->events.destroy, &fractionalScale->surfaceDestroy);
+    wl_list_insert(&server->fractionalScales, &fractionalScale->link);
+    sendFractionalScale(fractionalScale);
+}
+
+static const struct wp_fractional_scale_manager_v1_interface fractionalScaleManagerImpl = {
+    .destroy = destroyResource,
+    .get_fractional_scale = fractionalScaleManagerGet,
+};
+
+static void fractionalScaleManagerBind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wp_fractional_scale_manager_v1_interface, version, id);
+    if(resource == NULL) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &fractionalScaleManagerImpl, data, NULL);
+}
+
+//damage tracking
+
+//scales a box from layout units to output pixels, rounding outwards so nothing gets missed
+static void scaleBox(struct wlr_box *box, float scale) {
+    int x1 = floor(box->x * scale), y1 = floor(box->y * scale);
+    int x2 = ceil((box->x + box->width) * scale), y2 = ceil((box->y + box->height) * scale);
+    box->x = x1;
+    box->y = y1;
+    box->width = x2 - x1;
+    box->height = y2 - y1;
+}
+
+//where a surface lands on a monitor in pixels, the edges get rounded the same way everywhere
+//so a buffer a client made for this scale covers exactly its box and gets drawn 1:1
+static struct wlr_box surfaceOutputBox(struct wlr_surface *surface, int ox, int oy, float scale) {
+    int x1 = round(ox * scale), y1 = round(oy * scale);
+    return (struct wlr_box){
+        .x = x1,
+        .y = y1,
+        .width = (int)round((ox + surface->current.width) * scale) - x1,
+        .height = (int)round((oy + surface->current.height) * scale) - y1,
+    };
+}
+
+//adds a layout space box to the damage of every monitor it touches
+static void damageBox(struct TFWCServer *server, struct wlr_box *box) {
+    if(wlr_box_empty(box)) return;
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        struct wlr_box intersection;
+        if(!wlr_box_intersection(&intersection, box, &output->layoutBox)) continue;
+        struct wlr_box outputBox = { .x = box->x - output->layoutBox.x, .y = box->y - output->layoutBox.y, .width = box->width, .height = box->height };
+        scaleBox(&outputBox, output->wlrOutput->scale);
+        wlr_output_damage_add_box(output->damage, &outputBox);
+    }
+}
+
+//adds the damage of a single surface of a window to one monitor
+static void damageSurface(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct damageData *ddata = data;
+    struct TFWCView *view = ddata->view;
+    struct wlr_output *wlrOutput = ddata->output->wlrOutput;
+    if(ddata->onlySurface != NULL && ddata->onlySurface != surface) return;
+
+    int ox = view->x + sx - ddata->output->layoutBox.x, oy = view->y + sy - ddata->output->layoutBox.y;
+
+    if(ddata->whole) {
+        struct wlr_box box = { .x = ox, .y = oy, .width = surface->current.width, .height = surface->current.height };
+        scaleBox(&box, wlrOutput->scale);
+        wlr_output_damage_add_box(ddata->output->damage, &box);
+        return;
+    }
+
+    //only the part the client said changed in its last commit
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    wlr_surface_get_effective_damage(surface, &damage);
+    wlr_region_scale(&damage, &damage, wlrOutput->scale);
+    //scaled up textures get filtered, so the damage bleeds into neighbouring pixels
+    //and at fractional scales the rounded box can stretch the buffer by a pixel, even one drawn for this scale
+    int expand = ceil(wlrOutput->scale) - surface->current.scale;
+    if(expand < 1 && wlrOutput->scale != floorf(wlrOutput->scale)) expand = 1;
+    if(expand > 0) wlr_region_expand(&damage, &damage, expand);
+    //the surface gets drawn at the rounded origin of its box, so the damage has to be moved there too
+    struct wlr_box box = surfaceOutputBox(surface, ox, oy, wlrOutput->scale);
+    pixman_region32_translate(&damage, box.x, box.y);
+    wlr_output_damage_add(ddata->output->damage, &damage);
+    pixman_region32_fini(&damage);
+}
+
+//damages a window on the monitors its on, either fully or just what changed, optionally limited to one of its surfaces
+static void damageView(struct TFWCView *view, struct wlr_surface *onlySurface, bool whole) {
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &view->server->outputs, link) {
+        if(!viewOnOutput(view, output)) continue;
+        struct damageData ddata = {
+            .output = output,
+            .view = view,
+            .onlySurface = onlySurface,
+            .whole = whole,
+        };
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, damageSurface, &ddata);
+    }
+}
+
+//grows a box to also cover a surface of a window
+static void addSurfaceExtents(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct wlr_box *extents = data;
+    struct wlr_box box = { .x = sx, .y = sy, .width = surface->current.width, .height = surface->current.height };
+    if(wlr_box_empty(&box)) return;
+    if(wlr_box_empty(extents)) {
+        *extents = box;
+        return;
+    }
+    int x1 = box.x < extents->x ? box.x : extents->x;
+    int y1 = box.y < extents->y ? box.y : extents->y;
+    int x2 = box.x + box.width > extents->x + extents->width ? box.x + box.width : extents->x + extents->width;
+    int y2 = box.y + box.height > extents->y + extents->height ? box.y + box.height : extents->y + extents->height;
+    *extents = (struct wlr_box){ .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 };
+}
+
+//recalculates the layout space box a window and its popups cover
+static void updateViewExtents(struct TFWCView *view) {
+    struct wlr_box extents = { 0 };
+    wlr_xdg_surface_for_each_surface(view->xdgSurface, addSurfaceExtents, &extents);
+    extents.x += view->x;
+    extents.y += view->y;
+    view->extents = extents;
+    if(updateViewOutputs(view)) updateFractionalScales(view->server);
+    gridUpdateView(view);
+}
+
+//control socket events
+
+//window geometry in layout coordinates, which is what the control socket reports and moves
+static struct wlr_box viewGeometry(struct TFWCView *view) {
+    struct wlr_box box;
+    wlr_xdg_surface_get_geometry(view->xdgSurface, &box);
+    box.x += view->x;
+    box.y += view->y;
+    return box;
+}
+
+//makes room for length more bytes to send, they go out once the event loop sees the socket can take them
+//so all the replies and events that came up while handling a batch of input get written with one syscall
+static char *ipcReserve(struct TFWCIpcClient *client, size_t length) {
+    if(client->dropped) return NULL;
+    if(client->outLength + length > ipcMaxPending) {
+        //a subscriber that doesnt read its events doesnt get to make us buffer them forever
+        wlr_log(WLR_INFO, "control socket client stopped reading, dropping it");
+        client->dropped = true;
+        wl_event_source_fd_update(client->source, WL_EVENT_READABLE | WL_EVENT_WRITABLE);
+        return NULL;
+    }
+    if(client->outLength + length > client->outSize) {
+        size_t size = client->outSize ? client->outSize * 2 : 4096;
+        while(size < client->outLength + length) size *= 2;
+        char *out = realloc(client->out, size);
+        if(out == NULL) {
+            client->dropped = true;
+            return NULL;
+        }
+        client->out = out;
+        client->outSize = size;
+    }
+    if(client->outLength == 0) wl_event_source_fd_update(client->source, WL_EVENT_READABLE | WL_EVENT_WRITABLE);
+    char *data = client->out + client->outLength;
+    client->outLength += length;
+    return data;
+}
+
+static void ipcSend(struct TFWCIpcClient *client, uint32_t type, const void *body, uint32_t length) {
+    char *data = ipcReserve(client, sizeof(struct TFWCIpcHeader) + length);
+    if(data == NULL) return;
+    struct TFWCIpcHeader header = { .type = type, .length = length };
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), body, length);
+}
+
+//tells the clients that subscribed to an event about it, geometry events only go out if the geometry really changed
+static void ipcEmit(struct TFWCView *view, uint32_t event) {
+    struct TFWCServer *server = view->server;
+    if(server->ipcSubscribers == 0) return;
+    struct wlr_box box = viewGeometry(view);
+    if(event == TFWC_IPC_EVENT_GEOMETRY && memcmp(&box, &view->ipcBox, sizeof(struct wlr_box)) == 0) return;
+    view->ipcBox = box;
+    struct TFWCIpcEvent body = {
+        .event = event,
+        .id = view->id,
+        .x = box.x,
+        .y = box.y,
+        .width = box.width,
+        .height = box.height,
+    };
+    struct TFWCIpcClient *client;
+    wl_list_for_each(client, &server->ipcClients, link) {
+        if(client->events & event) ipcSend(client, TFWC_IPC_EVENT, &body, sizeof(body));
+    }
+}
+
+//window geometry setters
+
+//moves a window to the top of the stack
+static void raiseView(struct TFWCView *view) {
+    struct TFWCServer *server = view->server;
+    wl_list_remove(&view->link);
+    wl_list_insert(workspaceViews(server, view->workspace), &view->link);
+    view->stackOrder = ++server->stackCounter;
+    gridRaiseView(view);
+    if(viewShown(view)) damageBox(server, &view->extents);
+}
+
+//setter for window position
+void setWindowPosition(struct TFWCView *view, int x, int y) {
+    if(view->x == x && view->y == y) return;
+    if(viewShown(view)) damageBox(view->server, &view->extents);
+    view->x = x;
+    view->y = y;
+    if(view->mapped) {
+        updateViewExtents(view);
+        if(viewShown(view)) damageBox(view->server, &view->extents);
+        ipcEmit(view, TFWC_IPC_EVENT_GEOMETRY);
+    }
+}
+
+//setter for window size, a client only ever has one size configure in flight and newer sizes replace the queued one
+//so a slow client during an interactive resize doesnt get flooded
+//returns whether the client has a size to take, a window that already has that size doesnt get a configure at all
+bool setWindowSize(struct TFWCView *view, int w, int h) {
+    if(view->resizeSerial != 0) {
+        view->resizeQueued = true;
+        view->queuedWidth = w;
+        view->queuedHeight = h;
+        return true;
+    }
+    view->resizeSerial = wlr_xdg_toplevel_set_size(view->xdgSurface, w, h);
+    return view->resizeSerial != 0;
+}
+
+//called when a client acked a configure, which lets the next queued size through
+static void xdgAckConfigure(struct wl_listener *listener, void *data) {
+    struct TFWCView *view = wl_container_of(listener, view, ackConfigure);
+    struct wlr_xdg_surface_configure *configure = data;
+    if(view->resizeSerial == 0 || (int32_t)(configure->serial - view->resizeSerial) < 0) return;
+    view->resizeSerial = 0;
+    if(view->resizeQueued) {
+        view->resizeQueued = false;
+        setWindowSize(view, view->queuedWidth, view->queuedHeight);
+    }
+}
+
+//starts moving or resizing a window with the pointer
+static void beginInteractive(struct TFWCView *view, enum TFWCCursorMode mode, uint32_t edges) {
+    struct TFWCServer *server = view->server;
+    struct wlr_box geo_box;
+    wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
+    server->grabbedView = view;
+    server->cursorMode = mode;
+    view->anchorEdges = 0;
+    if(mode == TFWC_CURSOR_MOVE) {
+        server->grabedX = server->cursor->x - view->x;
+        server->grabedY = server->cursor->y - view->y;
+        return;
+    }
+
+    //for resizes the grab offset is from the edges being dragged
+    double borderX = view->x + geo_box.x + ((edges & WLR_EDGE_RIGHT) ? geo_box.width : 0);
+    double borderY = view->y + geo_box.y + ((edges & WLR_EDGE_BOTTOM) ? geo_box.height : 0);
+    server->grabedX = server->cursor->x - borderX;
+    server->grabedY = server->cursor->y - borderY;
+    server->grabGeobox = geo_box;
+    server->grabGeobox.x += view->x;
+    server->grabGeobox.y += view->y;
+    server->resizeEdges = edges;
+    view->anchorEdges = edges & (WLR_EDGE_LEFT | WLR_EDGE_TOP);
+    view->anchorRight = server->grabGeobox.x + server->grabGeobox.width;
+    view->anchorBottom = server->grabGeobox.y + server->grabGeobox.height;
+    wlr_xdg_toplevel_set_resizing(view->xdgSurface, true);
+}
+
+//stops whatever the pointer was grabbing
+static void endInteractive(struct TFWCServer *server) {
+    if(server->cursorMode == TFWC_CURSOR_RESIZE) wlr_xdg_toplevel_set_resizing(server->grabbedView->xdgSurface, false);
+    server->cursorMode = TFWC_CURSOR_PASSTHROUGH;
+    server->grabbedView = NULL;
+}
+
+//idle stuff
+
+//whether a client that can currently be seen asked for the screen to stay on
+static bool idleInhibited(struct TFWCServer *server) {
+    struct wlr_idle_inhibitor_v1 *inhibitor;
+    wl_list_for_each(inhibitor, &server->idleInhibitManager->inhibitors, link) {
+        struct wlr_surface *surface = wlr_surface_get_root_surface(inhibitor->surface);
+        if(!wlr_surface_is_xdg_surface(surface)) return true;
+        struct TFWCView *view = wlr_xdg_surface_from_wlr_surface(surface)->data;
+        if(view == NULL || !viewHidden(view)) return true;
+    }
+    return false;
+}
+
+//turns every monitor off or back on
+static void setOutputsPower(struct TFWCServer *server, bool on) {
+    if(server->outputsOff == !on) return;
+    server->outputsOff = !on;
+    wlr_log(WLR_INFO, "turning monitors %s", on ? "on" : "off");
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        wlr_output_enable(output->wlrOutput, on);
+        if(!wlr_output_commit(output->wlrOutput)) wlr_log(WLR_ERROR, "failed to turn %s %s", output->wlrOutput->name, on ? "on" : "off");
+        if(on) wlr_output_damage_add_whole(output->damage);
+    }
+}
+
+//called on any input, the time of the last input is always kept but idle protocol clients only hear about it every idleNotifyInterval
+static void notifyActivity(struct TFWCServer *server) {
+    clock_gettime(CLOCK_MONOTONIC, &server->lastActivity);
+    if(server->outputsOff) setOutputsPower(server, true);
+    if(nsSince(&server->lastIdleNotify) < idleNotifyInterval * 1000000ull) return;
+    server->lastIdleNotify = server->lastActivity;
+    wlr_idle_notify_activity(server->idle, server->seat);
+}
+
+//checks how long the seat has been idle, and turns the monitors off once its been long enough
+static int idleTick(void *data) {
+    struct TFWCServer *server = data;
+    int idleFor = nsSince(&server->lastActivity) / 1000000;
+    if(idleFor < server->idleTimeout) {
+        wl_event_source_timer_update(server->idleTimer, server->idleTimeout - idleFor);
+        return 0;
+    }
+    if(!server->outputsOff && !idleInhibited(server)) setOutputsPower(server, false);
+    wl_event_source_timer_update(server->idleTimer, server->idleTimeout);
+    return 0;
+}
+
+static void idleInhibitorDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCIdleInhibitor *inhibitor = wl_container_of(listener, inhibitor, destroy);
+    struct TFWCServer *server = inhibitor->server;
+    if(--server->idleInhibitors == 0) wlr_idle_set_enabled(server->idle, NULL, true);
+    wl_list_remove(&inhibitor->destroy.link);
+    free(inhibitor);
+}
+
+//called when a client like a video player asks for the screen to stay on
+static void serverNewIdleInhibitor(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, newIdleInhibitor);
+    struct wlr_idle_inhibitor_v1 *wlrInhibitor = data;
+    struct TFWCIdleInhibitor *inhibitor = calloc(1, sizeof(struct TFWCIdleInhibitor));
+    inhibitor->server = server;
+    inhibitor->destroy.notify = idleInhibitorDestroy;
+    wl_signal_add(&wlrInhibitor->events.destroy, &inhibitor->destroy);
+    if(server->idleInhibitors++ == 0) wlr_idle_set_enabled(server->idle, NULL, false);
+}
+
+//keymap cache
+
+static bool sameName(const char *a, const char *b) {
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static char *copyName(const char *name) {
+    return name ? strdup(name) : NULL;
+}
+
+//returns the keymap for some rule names, it only gets compiled the first time they come up
+//so a hub full of identical keyboards doesnt compile the same keymap over and over
+static struct xkb_keymap *getKeymap(struct TFWCServer *server, const struct xkb_rule_names *rules) {
+    struct TFWCKeymap *cached;
+    wl_list_for_each(cached, &server->keymaps, link) {
+        if(sameName(cached->rules, rules->rules) && sameName(cached->model, rules->model) && sameName(cached->layout, rules->layout) &&
+            sameName(cached->variant, rules->variant) && sameName(cached->options, rules->options)) return cached->keymap;
+    }
+
+    if(server->xkbContext == NULL) server->xkbContext = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if(server->xkbContext == NULL) return NULL;
+    uint64_t trace = traceBegin();
+    struct xkb_keymap *keymap = xkb_keymap_new_from_names(server->xkbContext, rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    traceEnd(trace, "keymap_compile", 0, NULL, 0);
+    if(keymap == NULL) return NULL;
+    cached = calloc(1, sizeof(struct TFWCKeymap));
+    cached->rules = copyName(rules->rules);
+    cached->model = copyName(rules->model);
+    cached->layout = copyName(rules->layout);
+    cached->variant = copyName(rules->variant);
+    cached->options = copyName(rules->options);
+    cached->keymap = keymap;
+    wl_list_insert(&server->keymaps, &cached->link);
+    return keymap;
+}
+
+static void freeKeymaps(struct TFWCServer *server) {
+    struct TFWCKeymap *cached, *tmp;
+    wl_list_for_each_safe(cached, tmp, &server->keymaps, link) {
+        xkb_keymap_unref(cached->keymap);
+        free(cached->rules);
+        free(cached->model);
+        free(cached->layout);
+        free(cached->variant);
+        free(cached->options);
+        free(cached);
+    }
+    if(server->xkbContext) xkb_context_unref(server->xkbContext);
+}
+
+//keyboard stuff
+
+//keyboard modifier key event handling
+static void keyboard_handle_modifiers(struct wl_listener *listener, void *data) {
+    struct TFWCKeyboard *keyboard = wl_container_of(listener, keyboard, modifiers);
+    notifyActivity(keyboard->server);
+    wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
+    wlr_seat_keyboard_notify_modifiers(keyboard->server->seat, &keyboard->device->keyboard->modifiers);
+}
+
+//window that has keyboard focus
+static struct TFWCView *focusedView(struct TFWCServer *server) {
+    struct wlr_surface *surface = server->seat->keyboard_state.focused_surface;
+    if(surface == NULL || !wlr_surface_is_xdg_surface(surface)) return NULL;
+    return wlr_xdg_surface_from_wlr_surface(surface)->data;
+}
+
+//workspaces
+
+static void processCursorMotion(struct TFWCServer *server, uint32_t time);
+
+//takes keyboard focus away from a window that stopped being shown, until something else gets focused nothing has it
+static void unfocusHidden(struct TFWCServer *server) {
+    struct TFWCView *view = focusedView(server);
+    if(view == NULL || view->workspace == server->activeWorkspace) return;
+    wlr_xdg_toplevel_set_activated(view->xdgSurface, false);
+    wlr_seat_keyboard_clear_focus(server->seat);
+}
+
+//shows another workspace on every monitor, the windows of the old and new one trade places with a few pointer writes
+//so switching costs the same no matter how many windows there are
+static void switchWorkspace(struct TFWCServer *server, int workspace) {
+    if(workspace == server->activeWorkspace) return;
+    struct TFWCWorkspace *from = &server->workspaces[server->activeWorkspace], *to = &server->workspaces[workspace];
+    wl_list_insert_list(&from->views, &server->views);
+    wl_list_init(&server->views);
+    wl_list_insert_list(&server->views, &to->views);
+    wl_list_init(&to->views);
+    server->activeWorkspace = workspace;
+    server->grid = workspaceGrid(server, workspace);
+    traceInstant("workspace", 0, 0, "workspace", workspace + 1);
+
+    if(server->grabbedView != NULL) endInteractive(server);
+    unfocusHidden(server);
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) wlr_output_damage_add_whole(output->damage);
+    //the pointer is over a different window now even though it didnt move
+    processCursorMotion(server, server->motionTime);
+}
+
+//puts a window on top of the stack of another workspace
+static void moveViewToWorkspace(struct TFWCView *view, int workspace) {
+    struct TFWCServer *server = view->server;
+    if(view->workspace == workspace) return;
+    if(viewShown(view)) damageBox(server, &view->extents);
+    gridRemoveView(view);
+    wl_list_remove(&view->link);
+    view->workspace = workspace;
+    wl_list_insert(workspaceViews(server, workspace), &view->link);
+    view->stackOrder = ++server->stackCounter;
+    gridUpdateView(view);
+    if(viewShown(view)) damageBox(server, &view->extents);
+
+    if(server->grabbedView == view) endInteractive(server);
+    unfocusHidden(server);
+    processCursorMotion(server, server->motionTime);
+}
+
+//setting window focus for keyboard inputs
+static void focus_view(struct TFWCView *view, struct wlr_surface *surface) {
+    if(view == NULL) return;
+    struct TFWCServer *server = view->server;
+    //a window on another workspace takes the user there
+    switchWorkspace(server, view->workspace);
+    struct wlr_seat *seat = server->seat;
+    struct wlr_surface *prev_surface = seat->keyboard_state.focused_surface;
+    if (prev_surface == surface) return;
+
+    //deactivate previous window
+    if (prev_surface) {
+        struct wlr_xdg_surface *previous = wlr_xdg_surface_from_wlr_surface(seat->keyboard_state.focused_surface);
+        wlr_xdg_toplevel_set_activated(previous, false);
+    }
+    struct wlr_keyboard *keyboard = wlr_seat_get_keyboard(seat);
+
+    //move the window to the top
+    raiseView(view);
+
+    //activate new surface
+    wlr_xdg_toplevel_set_activated(view->xdgSurface, true);
+    if(keyboard != NULL) wlr_seat_keyboard_notify_enter(seat, view->xdgSurface->surface, keyboard->keycodes, keyboard->num_keycodes, &keyboard->modifiers);
+    ipcEmit(view, TFWC_IPC_EVENT_FOCUS);
+}
+
+//keybinding stuff
+
+extern char **environ;
+
+//starts a program without a shell in between, posix_spawn uses vfork so this stays fast no matter how big the compositor gets
+static pid_t spawnProgram(char *const argv[]) {
+    //the event loop blocks the signals it handles, programs shouldnt inherit that
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if(err != 0) {
+        wlr_log(WLR_ERROR, "failed to start %s: %s", argv[0], strerror(err));
+        return -1;
+    }
+    return pid;
+}
+
+//reaps programs that exited so they dont stay around as zombies
+static int reapChildren(int signal, void *data) {
+    struct TFWCServer *server = data;
+    pid_t pid;
+    while((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        if(server->bench && pid == server->bench->clientPid) server->bench->clientPid = 0;
+    }
+    return 0;
+}
+
+static void keybindSpawn(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(pressed) spawnProgram(bind->argv);
+}
+
+static void keybindClose(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(!pressed) return;
+    struct TFWCView *view = focusedView(server);
+    if(view != NULL) wlr_xdg_toplevel_send_close(view->xdgSurface);
+}
+
+//focuses the bottom window, which raises it so pressing it again goes through all of them
+static void keybindFocusNext(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(!pressed) return;
+    struct TFWCView *view;
+    wl_list_for_each_reverse(view, &server->views, link) {
+        if(!view->mapped) continue;
+        focus_view(view, view->xdgSurface->surface);
+        return;
+    }
+}
+
+//moves the window under the cursor for as long as the key is held
+static void keybindMove(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(!pressed) {
+        if(server->cursorMode == TFWC_CURSOR_MOVE) endInteractive(server);
+        return;
+    }
+    if(server->cursorMode != TFWC_CURSOR_PASSTHROUGH) return;
+    double sx, sy;
+    struct wlr_surface *surface = NULL;
+    struct TFWCView *view = desktop_view_at(server, server->cursor->x, server->cursor->y, &surface, &sx, &sy);
+    if(view == NULL) return;
+    focus_view(view, view->xdgSurface->surface);
+    beginInteractive(view, TFWC_CURSOR_MOVE, 0);
+}
+
+//gives focus to the top window of the shown workspace when the focused one went away
+static void focusTopView(struct TFWCServer *server) {
+    if(focusedView(server) != NULL) return;
+    struct TFWCView *view;
+    wl_list_for_each(view, &server->views, link) {
+        if(!view->mapped) continue;
+        focus_view(view, view->xdgSurface->surface);
+        return;
+    }
+}
+
+static void keybindWorkspace(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(!pressed) return;
+    switchWorkspace(server, bind->sym - XKB_KEY_1);
+    focusTopView(server);
+}
+
+static void keybindSendToWorkspace(struct TFWCServer *server, const struct TFWCKeybind *bind, bool pressed) {
+    if(!pressed) return;
+    struct TFWCView *view = focusedView(server);
+    if(view == NULL) return;
+    moveViewToWorkspace(view, bind->sym - XKB_KEY_1);
+    focusTopView(server);
+}
+
+static char *const terminalCommand[] = { "st", NULL };
+
+static const struct TFWCKeybind defaultKeybinds[] = {
+    { compositorKey, XKB_KEY_Return, keybindSpawn, terminalCommand },
+    { compositorKey, XKB_KEY_q, keybindClose, NULL },
+    { compositorKey, XKB_KEY_Tab, keybindFocusNext, NULL },
+    { compositorKey, XKB_KEY_m, keybindMove, NULL },
+    { compositorKey, XKB_KEY_1, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_2, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_3, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_4, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_5, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_6, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_7, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_8, keybindWorkspace, NULL },
+    { compositorKey, XKB_KEY_9, keybindWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_1, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_2, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_3, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_4, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_5, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_6, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_7, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_8, keybindSendToWorkspace, NULL },
+    { compositorKey | WLR_MODIFIER_SHIFT, XKB_KEY_9, keybindSendToWorkspace, NULL },
+};
+
+static uint32_t keybindHash(uint32_t modifiers, xkb_keysym_t sym) {
+    return ((sym * 2654435761u) ^ (modifiers * 40503u)) & (keybindBuckets - 1);
+}
+
+//adds a binding to the open addressed table, a binding for the same keys replaces the old one
+static bool keybindAdd(struct TFWCServer *server, const struct TFWCKeybind *bind) {
+    uint32_t index = keybindHash(bind->modifiers, bind->sym);
+    for(int probes = 0; probes < keybindBuckets; probes++) {
+        const struct TFWCKeybind *slot = server->keybinds[index];
+        if(slot == NULL || (slot->modifiers == bind->modifiers && slot->sym == bind->sym)) {
+            server->keybinds[index] = bind;
+            return true;
+        }
+        index = (index + 1) & (keybindBuckets - 1);
+    }
+    return false;
+}
+
+static const struct TFWCKeybind *keybindFind(struct TFWCServer *server, uint32_t modifiers, xkb_keysym_t sym) {
+    uint32_t index = keybindHash(modifiers, sym);
+    for(int probes = 0; probes < keybindBuckets && server->keybinds[index] != NULL; probes++) {
+        const struct TFWCKeybind *bind = server->keybinds[index];
+        if(bind->modifiers == modifiers && bind->sym == sym) return bind;
+        index = (index + 1) & (keybindBuckets - 1);
+    }
+    return NULL;
+}
+
+//handles a key press or release, bindings get it first and everything else goes to the focused program
+static void processKey(struct TFWCKeyboard *keyboard, struct wlr_event_keyboard_key *event) {
+    struct TFWCServer *server = keyboard->server;
+    struct wlr_seat *seat = server->seat;
+    uint32_t keycode = event->keycode + 8;
+    notifyActivity(server);
+
+    if(event->state == WL_KEYBOARD_KEY_STATE_RELEASED) {
+        //releasing a key that triggered a binding, even if the modifier already got let go
+        for(int i = 0; i < keyboard->heldCount; i++) {
+            if(keyboard->heldKeycodes[i] != keycode) continue;
+            const struct TFWCKeybind *bind = keyboard->heldBinds[i];
+            keyboard->heldCount--;
+            keyboard->heldKeycodes[i] = keyboard->heldKeycodes[keyboard->heldCount];
+            keyboard->heldBinds[i] = keyboard->heldBinds[keyboard->heldCount];
+            bind->action(server, bind, false);
+            return;
+        }
+    } else if(keyboard->heldCount < heldKeysMax) {
+        //bindings use the unshifted keysym so shift can be one of their modifiers
+        struct wlr_keyboard *wlrKeyboard = keyboard->device->keyboard;
+        uint32_t modifiers = wlr_keyboard_get_modifiers(wlrKeyboard) & keybindModifiers;
+        xkb_layout_index_t layout = xkb_state_key_get_layout(wlrKeyboard->xkb_state, keycode);
+        const xkb_keysym_t *syms;
+        int nsyms = xkb_keymap_key_get_syms_by_level(wlrKeyboard->keymap, keycode, layout, 0, &syms);
+        for(int i = 0; i < nsyms; i++) {
+            const struct TFWCKeybind *bind = keybindFind(server, modifiers, syms[i]);
+            if(bind == NULL) continue;
+            keyboard->heldKeycodes[keyboard->heldCount] = keycode;
+            keyboard->heldBinds[keyboard->heldCount] = bind;
+            keyboard->heldCount++;
+            bind->action(server, bind, true);
+            return;
+        }
+    }
+
+    //all other keypresses get sent to the current program
+    wlr_seat_set_keyboard(seat, keyboard->device);
+    wlr_seat_keyboard_notify_key(seat, event->time_msec, event->keycode, event->state);
+}
+
+//keyboard key press event handeler
+static void keyboard_handle_key(struct wl_listener *listener, void *data) {
+    struct TFWCKeyboard *keyboard = wl_container_of(listener, keyboard, key);
+    struct wlr_event_keyboard_key *event = data;
+    uint64_t trace = traceBegin();
+    processKey(keyboard, event);
+    traceEnd(trace, "key", 0, "keycode", event->keycode);
+}
+
+//handle clipboard setting requests
+static void seatRequestSetSelection(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, requestSetSelection);
+    struct wlr_seat_request_set_selection_event *event = data;
+    wlr_seat_set_selection(server->seat, event->source, event->serial);
+}
+
+//mouse stuff
+
+//handle programs sending custom cursor images
+static void seatRequestCursor(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, requestCursor);
+    struct wlr_seat_pointer_request_set_cursor_event *event = data;
+    struct wlr_seat_client *focused_client = server->seat->pointer_state.focused_client;
+    if(focused_client == event->seat_client) {
+        wlr_cursor_set_surface(server->cursor, event->surface, event->hotspot_x, event->hotspot_y);
+        server->cursorImage = NULL;
+    }
+}
+
+//loads the cursor theme at the scale of every monitor that doesnt have it yet, so only the scales actually in use ever get loaded
+//returns whether anything was loaded, monitors at the new scale only get the cursor image once its set again
+static bool loadCursorThemes(struct TFWCServer *server) {
+    bool loaded = false;
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        float scale = output->wlrOutput->scale;
+        bool found = false;
+        struct wlr_xcursor_manager_theme *theme;
+        wl_list_for_each(theme, &server->cursorManager->scaled_themes, link) found |= theme->scale == scale;
+        if(found) continue;
+        uint64_t trace = traceBegin();
+        wlr_xcursor_manager_load(server->cursorManager, scale);
+        traceEnd(trace, "cursor_theme_load", 0, "scale_percent", scale * 100);
+        loaded = true;
+    }
+    return loaded;
+}
+
+//sets the cursor to an image from the theme, every change has to be uploaded to the cursor plane again so we skip ones that wouldnt change anything
+static void setCursorImage(struct TFWCServer *server, const char *name) {
+    if(server->cursorImage != NULL && strcmp(server->cursorImage, name) == 0) return;
+    server->cursorImage = name;
+    wlr_xcursor_manager_set_cursor_image(server->cursorManager, name, server->cursor);
+}
+
+//moves the grabbed window along with the pointer
+static void processCursorMove(struct TFWCServer *server) {
+    setWindowPosition(server->grabbedView, server->cursor->x - server->grabedX, server->cursor->y - server->grabedY);
+}
+
+//resizes the grabbed window by the dragged edges, the window only moves once the client commits the new size
+static void processCursorResize(struct TFWCServer *server) {
+    struct TFWCView *view = server->grabbedView;
+    double borderX = server->cursor->x - server->grabedX;
+    double borderY = server->cursor->y - server->grabedY;
+    int newLeft = server->grabGeobox.x;
+    int newRight = server->grabGeobox.x + server->grabGeobox.width;
+    int newTop = server->grabGeobox.y;
+    int newBottom = server->grabGeobox.y + server->grabGeobox.height;
+
+    if(server->resizeEdges & WLR_EDGE_TOP) {
+        newTop = borderY;
+        if(newTop >= newBottom) newTop = newBottom - 1;
+    } else if(server->resizeEdges & WLR_EDGE_BOTTOM) {
+        newBottom = borderY;
+        if(newBottom <= newTop) newBottom = newTop + 1;
+    }
+    if(server->resizeEdges & WLR_EDGE_LEFT) {
+        newLeft = borderX;
+        if(newLeft >= newRight) newLeft = newRight - 1;
+    } else if(server->resizeEdges & WLR_EDGE_RIGHT) {
+        newRight = borderX;
+        if(newRight <= newLeft) newRight = newLeft + 1;
+    }
+    setWindowSize(view, newRight - newLeft, newBottom - newTop);
+}
+
+//handle cursor motion events
+static void processCursorMotion(struct TFWCServer *server, uint32_t time) {
+    if(server->cursorMode == TFWC_CURSOR_MOVE) {
+        processCursorMove(server);
+        return;
+    } else if(server->cursorMode == TFWC_CURSOR_RESIZE) {
+        processCursorResize(server);
+        return;
+    }
+
+    double sx, sy;
+    struct wlr_seat *seat = server->seat;
+    struct wlr_surface *surface = NULL;
+    uint64_t trace = traceBegin();
+    struct TFWCView *view = desktop_view_at(server, server->cursor->x, server->cursor->y, &surface, &sx, &sy);
+    traceEnd(trace, "hit_test", 0, "window", view ? view->id : 0);
+    if (!view) { //if cursor isnt over a window will it default to the normal pointer
+        setCursorImage(server, "left_ptr");
+    }
+    if (!surface) {
+        if(seat->pointer_state.focused_surface != NULL) wlr_seat_pointer_clear_focus(seat);
+        return;
+    }
+
+    //clients already got every motion event, so they only hear from us here when the surface under the pointer changed or moved
+    double originX = server->cursor->x - sx, originY = server->cursor->y - sy;
+    if(surface != seat->pointer_state.focused_surface) {
+        wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
+    } else if(originX != server->pointerOriginX || originY != server->pointerOriginY) {
+        wlr_seat_pointer_notify_motion(seat, time, sx, sy);
+    }
+    server->pointerOriginX = originX;
+    server->pointerOriginY = originY;
+    server->pointerWidth = surface->current.width;
+    server->pointerHeight = surface->current.height;
+}
+
+//runs the hit test and grab work for all the motion that came in since it was last done
+static void flushCursorMotion(struct TFWCServer *server) {
+    if(server->motionIdle == NULL) return;
+    wl_event_source_remove(server->motionIdle);
+    server->motionIdle = NULL;
+    processCursorMotion(server, server->motionTime);
+}
+
+static void cursorMotionIdle(void *data) {
+    struct TFWCServer *server = data;
+    server->motionIdle = NULL;
+    processCursorMotion(server, server->motionTime);
+}
+
+//the focused surface gets the motion right away while the pointer stays inside it, everything else waits until the event loop has read all pending input
+//so a 1000hz mouse or a tablet only costs one hit test per burst of events
+static void queueCursorMotion(struct TFWCServer *server, uint32_t time) {
+    server->motionTime = time;
+    double sx = server->cursor->x - server->pointerOriginX, sy = server->cursor->y - server->pointerOriginY;
+    if(server->cursorMode == TFWC_CURSOR_PASSTHROUGH && server->seat->pointer_state.focused_surface != NULL &&
+            sx >= 0 && sy >= 0 && sx < server->pointerWidth && sy < server->pointerHeight) {
+        wlr_seat_pointer_notify_motion(server->seat, time, sx, sy);
+    }
+    if(server->motionIdle == NULL) {
+        server->motionIdle = wl_event_loop_add_idle(wl_display_get_event_loop(server->display), cursorMotionIdle, server);
+    }
+}
+
+//handle relative cursor movement envents
+static void serverCursorMotion(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, cursorMotion);
+    struct wlr_event_pointer_motion *event = data;
+    uint64_t trace = traceBegin();
+    notifyActivity(server);
+    wlr_cursor_move(server->cursor, event->device, event->delta_x, event->delta_y);
+    queueCursorMotion(server, event->time_msec);
+    traceEnd(trace, "pointer_motion", 0, NULL, 0);
+}
+
+//handle absolute cursor events, like drawing pads send for example
+static void serverCursorMotionAbsolute(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, cursorMotionAbsolute);
+    struct wlr_event_pointer_motion_absolute *event = data;
+    uint64_t trace = traceBegin();
+    notifyActivity(server);
+    wlr_cursor_warp_absolute(server->cursor, event->device, event->x, event->y);
+    queueCursorMotion(server, event->time_msec);
+    traceEnd(trace, "pointer_motion_absolute", 0, NULL, 0);
+}
+
+//handle mouse clicks
+static void processCursorButton(struct TFWCServer *server, uint32_t time, uint32_t button, enum wlr_button_state state) {
+    //the click has to go to whatever is under the pointer now
+    flushCursorMotion(server);
+    wlr_seat_pointer_notify_button(server->seat, time, button, state);
+
+    //letting go of the button ends a move or resize
+    if(state == WLR_BUTTON_RELEASED && server->cursorMode != TFWC_CURSOR_PASSTHROUGH) {
+        endInteractive(server);
+        return;
+    }
+
+    double sx, sy;
+    struct wlr_surface *surface;
+    struct TFWCView *view = desktop_view_at(server,server->cursor->x, server->cursor->y, &surface, &sx, &sy);
+    focus_view(view, surface);
+}
+
+static void serverCursorButton(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, cursorButton);
+    struct wlr_event_pointer_button *event = data;
+    uint64_t trace = traceBegin();
+    notifyActivity(server);
+    processCursorButton(server, event->time_msec, event->button, event->state);
+    traceEnd(trace, "pointer_button", 0, "button", event->button);
+}
+
+//handle frame events
+static void serverCursorFrame(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, cursorFrame);
+    uint64_t trace = traceBegin();
+    wlr_seat_pointer_notify_frame(server->seat);
+    traceEnd(trace, "pointer_frame", 0, NULL, 0);
+}
+
+//handle axis events such as scrolling
+static void serverCursorAxis(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, cursorAxis);
+    struct wlr_event_pointer_axis *event = data;
+    uint64_t trace = traceBegin();
+    notifyActivity(server);
+    flushCursorMotion(server);
+    wlr_seat_pointer_notify_axis(server->seat, event->time_msec, event->orientation, event->delta, event->delta_discrete, event->source);
+    traceEnd(trace, "pointer_axis", 0, NULL, 0);
+}
+
+//control socket
+
+//finds a window by the id the control socket knows it under
+static struct TFWCView *findViewId(struct TFWCServer *server, uint32_t id) {
+    struct TFWCView *view = server->viewIds[id & (viewIdBuckets - 1)];
+    while(view != NULL && view->id != id) view = view->idNext;
+    return view;
+}
+
+//lets the held back frames go out, everything the batch changed is already in the damage
+static void batchRelease(struct TFWCServer *server) {
+    wl_event_source_timer_update(server->batchTimer, 0);
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) wlr_output_schedule_frame(output->wlrOutput);
+}
+
+//a window of a batch got its new size or went away, so its move goes through now as well
+static void batchViewDone(struct TFWCView *view) {
+    struct TFWCServer *server = view->server;
+    if(!view->batchPending) return;
+    view->batchPending = false;
+    if(view->batchMove) {
+        view->batchMove = false;
+        struct wlr_box geo_box;
+        wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
+        setWindowPosition(view, view->batchX - geo_box.x, view->batchY - geo_box.y);
+    }
+    if(--server->batchPending == 0) batchRelease(server);
+}
+
+//windows that dont take their new size in time dont get to hold up the screen any longer
+static int batchTimerFired(void *data) {
+    struct TFWCServer *server = data;
+    wlr_log(WLR_DEBUG, "control socket batch timed out waiting for %d windows", server->batchPending);
+    struct TFWCView *view;
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) batchViewDone(view);
+    }
+    return 0;
+}
+
+//checks a whole batch before applying any of it, so a bad batch leaves every window as it was
+static struct TFWCIpcStatus ipcCheckBatch(struct TFWCServer *server, const char *body, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        struct TFWCIpcOp op;
+        memcpy(&op, body + i * sizeof(op), sizeof(op));
+        struct TFWCView *view = findViewId(server, op.id);
+        if(view == NULL) return (struct TFWCIpcStatus){ TFWC_IPC_NO_WINDOW, i };
+        bool valid = op.op == TFWC_IPC_OP_MOVE || op.op == TFWC_IPC_OP_CLOSE ||
+            (op.op == TFWC_IPC_OP_RESIZE && op.a > 0 && op.b > 0) ||
+            (op.op == TFWC_IPC_OP_FOCUS && view->mapped) ||
+            (op.op == TFWC_IPC_OP_WORKSPACE && op.a >= 1 && op.a <= workspaceCount);
+        if(!valid) return (struct TFWCIpcStatus){ TFWC_IPC_BAD_OP, i };
+    }
+    return (struct TFWCIpcStatus){ TFWC_IPC_OK, 0 };
+}
+
+//applies a batch of operations, all of it lands in the same frame
+//moves alone already do since they only add damage, but resized windows have to draw at their new size first
+//so frames are held back until every resized window committed its new size, and windows that move too only move then
+static void ipcApplyBatch(struct TFWCServer *server, const char *body, size_t count) {
+    bool held = server->batchPending > 0;
+    for(size_t i = 0; i < count; i++) {
+        struct TFWCIpcOp op;
+        memcpy(&op, body + i * sizeof(op), sizeof(op));
+        struct TFWCView *view = findViewId(server, op.id);
+        switch(op.op) {
+            case TFWC_IPC_OP_MOVE:
+                view->anchorEdges = 0;
+                view->batchMove = true;
+                view->batchX = op.a;
+                view->batchY = op.b;
+                break;
+            case TFWC_IPC_OP_RESIZE:
+                if(setWindowSize(view, op.a, op.b) && !view->batchPending) {
+                    view->batchPending = true;
+                    server->batchPending++;
+                }
+                break;
+            case TFWC_IPC_OP_FOCUS:
+                focus_view(view, view->xdgSurface->surface);
+                break;
+            case TFWC_IPC_OP_CLOSE:
+                wlr_xdg_toplevel_send_close(view->xdgSurface);
+                break;
+            case TFWC_IPC_OP_WORKSPACE:
+                moveViewToWorkspace(view, op.a - 1);
+                break;
+        }
+    }
+
+    //windows that ended up on other workspaces dont get to hold back frames nobody would see them in
+    //this is only known once the whole batch is applied, since a later op can move a window or switch workspaces
+    //windows that only move can move right away
+    for(size_t i = 0; i < count; i++) {
+        struct TFWCIpcOp op;
+        memcpy(&op, body + i * sizeof(op), sizeof(op));
+        struct TFWCView *view = findViewId(server, op.id);
+        if(view->batchPending && !viewShown(view)) batchViewDone(view);
+        if(!view->batchMove || view->batchPending) continue;
+        view->batchMove = false;
+        struct wlr_box geo_box;
+        wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
+        setWindowPosition(view, view->batchX - geo_box.x, view->batchY - geo_box.y);
+    }
+    if(!held && server->batchPending > 0) wl_event_source_timer_update(server->batchTimer, ipcBatchTimeout);
+}
+
+static uint16_t ipcStringLength(const char *string) {
+    size_t length = string ? strlen(string) : 0;
+    return length > UINT16_MAX ? UINT16_MAX : length;
+}
+
+//sends every window from the top of the stack down, written straight into the output buffer
+static void ipcList(struct TFWCIpcClient *client) {
+    struct TFWCServer *server = client->server;
+    struct wlr_surface *focused = server->seat->keyboard_state.focused_surface;
+    struct TFWCView *view;
+    size_t length = 0;
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) {
+            struct wlr_xdg_toplevel *toplevel = view->xdgSurface->toplevel;
+            length += sizeof(struct TFWCIpcView) + ipcStringLength(toplevel->title) + ipcStringLength(toplevel->app_id);
+        }
+    }
+    char *data = ipcReserve(client, sizeof(struct TFWCIpcHeader) + length);
+    if(data == NULL) return;
+    struct TFWCIpcHeader header = { .type = TFWC_IPC_LIST, .length = length };
+    memcpy(data, &header, sizeof(header));
+    data += sizeof(header);
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) {
+            struct wlr_xdg_toplevel *toplevel = view->xdgSurface->toplevel;
+            struct wlr_box box = viewGeometry(view);
+            struct TFWCIpcView record = {
+                .id = view->id,
+                .x = box.x,
+                .y = box.y,
+                .width = box.width,
+                .height = box.height,
+                .flags = (view->mapped ? TFWC_IPC_VIEW_MAPPED : 0) | (focused == view->xdgSurface->surface ? TFWC_IPC_VIEW_FOCUSED : 0),
+                .workspace = view->workspace + 1,
+                .titleLength = ipcStringLength(toplevel->title),
+                .appIdLength = ipcStringLength(toplevel->app_id),
+            };
+            memcpy(data, &record, sizeof(record));
+            data += sizeof(record);
+            memcpy(data, toplevel->title, record.titleLength);
+            data += record.titleLength;
+            memcpy(data, toplevel->app_id, record.appIdLength);
+            data += record.appIdLength;
+        }
+    }
+}
+
+static void ipcHandleMessage(struct TFWCIpcClient *client, uint32_t type, const char *body, uint32_t length) {
+    struct TFWCServer *server = client->server;
+    struct TFWCIpcStatus status = { TFWC_IPC_OK, 0 };
+    switch(type) {
+        case TFWC_IPC_LIST:
+            ipcList(client);
+            return;
+        case TFWC_IPC_BATCH:
+            if(length % sizeof(struct TFWCIpcOp) != 0) {
+                status.status = TFWC_IPC_BAD_MESSAGE;
+                break;
+            }
+            status = ipcCheckBatch(server, body, length / sizeof(struct TFWCIpcOp));
+            if(status.status == TFWC_IPC_OK) ipcApplyBatch(server, body, length / sizeof(struct TFWCIpcOp));
+            break;
+        case TFWC_IPC_SUBSCRIBE:
+            if(length != sizeof(uint32_t)) {
+                status.status = TFWC_IPC_BAD_MESSAGE;
+                break;
+            }
+            server->ipcSubscribers -= client->events != 0;
+            memcpy(&client->events, body, sizeof(uint32_t));
+            server->ipcSubscribers += client->events != 0;
+            break;
+        default:
+            status.status = TFWC_IPC_BAD_MESSAGE;
+            break;
+    }
+    ipcSend(client, type, &status, sizeof(status));
+}
+
+static void ipcClientDestroy(struct TFWCIpcClient *client) {
+    client->server->ipcSubscribers -= client->events != 0;
+    wl_event_source_remove(client->source);
+    close(client->fd);
+    wl_list_remove(&client->link);
+    free(client->in);
+    free(client->out);
+    free(client);
+}
+
+//writes as much of the output buffer as the socket takes, returns false if the client is gone
+static bool ipcFlush(struct TFWCIpcClient *client) {
+    ssize_t written = send(client->fd, client->out, client->outLength, MSG_NOSIGNAL);
+    if(written < 0) return errno == EAGAIN || errno == EINTR;
+    memmove(client->out, client->out + written, client->outLength - written);
+    client->outLength -= written;
+    if(client->outLength == 0) wl_event_source_fd_update(client->source, WL_EVENT_READABLE);
+    return true;
+}
+
+//reads whatever the client sent and handles every complete message in it
+static bool ipcRead(struct TFWCIpcClient *client) {
+    if(client->inLength == client->inSize) {
+        size_t size = client->inSize ? client->inSize * 2 : 4096;
+        if(size > sizeof(struct TFWCIpcHeader) + TFWC_IPC_MAX_MESSAGE) size = sizeof(struct TFWCIpcHeader) + TFWC_IPC_MAX_MESSAGE;
+        char *in = realloc(client->in, size);
+        if(in == NULL) return false;
+        client->in = in;
+        client->inSize = size;
+    }
+    ssize_t got = read(client->fd, client->in + client->inLength, client->inSize - client->inLength);
+    if(got == 0) return false;
+    if(got < 0) return errno == EAGAIN || errno == EINTR;
+    client->inLength += got;
+
+    size_t offset = 0;
+    while(client->inLength - offset >= sizeof(struct TFWCIpcHeader)) {
+        struct TFWCIpcHeader header;
+        memcpy(&header, client->in + offset, sizeof(header));
+        if(header.length > TFWC_IPC_MAX_MESSAGE) return false;
+        if(client->inLength - offset - sizeof(header) < header.length) break;
+        ipcHandleMessage(client, header.type, client->in + offset + sizeof(header), header.length);
+        offset += sizeof(header) + header.length;
+    }
+    memmove(client->in, client->in + offset, client->inLength - offset);
+    client->inLength -= offset;
+    return true;
+}
+
+static int ipcClientEvent(int fd, uint32_t mask, void *data) {
+    struct TFWCIpcClient *client = data;
+    bool alive = !client->dropped;
+    if(alive && (mask & WL_EVENT_READABLE)) alive = ipcRead(client);
+    if(alive && (mask & WL_EVENT_WRITABLE) && client->outLength > 0) alive = ipcFlush(client);
+    if(!alive || client->dropped || (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR))) ipcClientDestroy(client);
+    return 0;
+}
+
+static int ipcAccept(int fd, uint32_t mask, void *data) {
+    struct TFWCServer *server = data;
+    int clientFd = accept(fd, NULL, NULL);
+    if(clientFd < 0) return 0;
+    fcntl(clientFd, F_SETFL, O_NONBLOCK);
+    fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+    struct TFWCIpcClient *client = calloc(1, sizeof(struct TFWCIpcClient));
+    client->server = server;
+    client->fd = clientFd;
+    client->source = wl_event_loop_add_fd(wl_display_get_event_loop(server->display), clientFd, WL_EVENT_READABLE, ipcClientEvent, client);
+    wl_list_insert(&server->ipcClients, &client->link);
+    return 0;
+}
+
+//opens the control socket next to the wayland socket, programs we start find it in TFWC_SOCKET
+static bool ipcCreate(struct TFWCServer *server, const char *display) {
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if(runtimeDir == NULL) return false;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if(snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/tfwc.%s.sock", runtimeDir, display) >= (int)sizeof(addr.sun_path)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) return false;
+
+    //a socket left over from a compositor that crashed, the wayland socket it belongs to was free so nobody is using it
+    unlink(addr.sun_path);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return false;
+    }
+    server->ipcFd = fd;
+    memcpy(server->ipcPath, addr.sun_path, sizeof(server->ipcPath));
+    server->ipcSource = wl_event_loop_add_fd(wl_display_get_event_loop(server->display), fd, WL_EVENT_READABLE, ipcAccept, server);
+    setenv("TFWC_SOCKET", server->ipcPath, true);
+    return true;
+}
+
+static void ipcDestroy(struct TFWCServer *server) {
+    struct TFWCIpcClient *client, *tmp;
+    wl_list_for_each_safe(client, tmp, &server->ipcClients, link) ipcClientDestroy(client);
+    if(server->ipcSource == NULL) return;
+    wl_event_source_remove(server->ipcSource);
+    close(server->ipcFd);
+    unlink(server->ipcPath);
+}
+
+//tiled software compositing
+
+//draws every tile that hasnt been taken yet, each tile gets its jobs applied bottom to top so the result doesnt depend on who drew it
+static void tileWork(struct TFWCTileCompositor *tc) {
+    pixman_image_t *target = pixman_image_create_bits(tc->format, tc->width, tc->height, tc->data, tc->stride);
+    pixman_image_t **images = calloc(tc->jobCount, sizeof(pixman_image_t *));
+    pixman_region32_t clip;
+    pixman_region32_init(&clip);
+    int tile;
+    while((tile = __atomic_fetch_add(&tc->nextTile, 1, __ATOMIC_RELAXED)) < tc->tileCount) {
+        pixman_box32_t *box = &tc->tiles[tile];
+        for(int i = 0; i < tc->jobCount; i++) {
+            struct TFWCTileJob *job = &tc->jobs[i];
+            pixman_region32_intersect_rect(&clip, &job->region, box->x1, box->y1, box->x2 - box->x1, box->y2 - box->y1);
+            int nrects;
+            pixman_box32_t *rects = pixman_region32_rectangles(&clip, &nrects);
+            if(nrects == 0) continue;
+            if(job->data == NULL) {
+                pixman_image_fill_boxes(PIXMAN_OP_SRC, target, &job->color, nrects, rects);
+                continue;
+            }
+            if(images[i] == NULL) images[i] = pixman_image_create_bits(job->format, job->width, job->height, job->data, job->stride);
+            for(int r = 0; r < nrects; r++) {
+                pixman_image_composite32(PIXMAN_OP_OVER, images[i], NULL, target, rects[r].x1 - job->x, rects[r].y1 - job->y,
+                    0, 0, rects[r].x1, rects[r].y1, rects[r].x2 - rects[r].x1, rects[r].y2 - rects[r].y1);
+            }
+        }
+    }
+    pixman_region32_fini(&clip);
+    for(int i = 0; i < tc->jobCount; i++) {
+        if(images[i] != NULL) pixman_image_unref(images[i]);
+    }
+    free(images);
+    pixman_image_unref(target);
+}
+
+static void *tileWorker(void *data) {
+    struct TFWCTileCompositor *tc = data;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&tc->lock);
+    while(true) {
+        while(!tc->quit && tc->generation == seen) pthread_cond_wait(&tc->wake, &tc->lock);
+        if(tc->quit) break;
+        seen = tc->generation;
+        pthread_mutex_unlock(&tc->lock);
+        tileWork(tc);
+        pthread_mutex_lock(&tc->lock);
+        if(--tc->running == 0) pthread_cond_signal(&tc->finished);
+    }
+    pthread_mutex_unlock(&tc->lock);
+    return NULL;
+}
+
+static struct TFWCTileCompositor *tileCompositorCreate(int threads) {
+    struct TFWCTileCompositor *tc = calloc(1, sizeof(struct TFWCTileCompositor));
+    pthread_mutex_init(&tc->lock, NULL);
+    pthread_cond_init(&tc->wake, NULL);
+    pthread_cond_init(&tc->finished, NULL);
+    tc->workers = calloc(threads, sizeof(pthread_t));
+    tc->threads = 1;
+
+    //signals are read from the event loop on the main thread, the workers must never be the ones they get delivered to
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    for(int i = 0; i < threads - 1; i++) {
+        if(pthread_create(&tc->workers[i], NULL, tileWorker, tc) != 0) {
+            wlr_log(WLR_ERROR, "could only start %d of %d render threads", tc->threads, threads);
+            break;
+        }
+        tc->threads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return tc;
+}
+
+static void tileCompositorDestroy(struct TFWCTileCompositor *tc) {
+    pthread_mutex_lock(&tc->lock);
+    tc->quit = true;
+    pthread_cond_broadcast(&tc->wake);
+    pthread_mutex_unlock(&tc->lock);
+    for(int i = 0; i < tc->threads - 1; i++) pthread_join(tc->workers[i], NULL);
+    pthread_mutex_destroy(&tc->lock);
+    pthread_cond_destroy(&tc->wake);
+    pthread_cond_destroy(&tc->finished);
+    free(tc->workers);
+    free(tc->jobs);
+    free(tc->tiles);
+    free(tc->staging);
+    free(tc);
+}
+
+//starts a frame that gets drawn into the given pixels
+static void tileCompositorBegin(struct TFWCTileCompositor *tc, uint32_t *data, pixman_format_code_t format, int width, int height, int stride) {
+    tc->data = data;
+    tc->format = format;
+    tc->width = width;
+    tc->height = height;
+    tc->stride = stride;
+    tc->jobCount = 0;
+    tc->stagingUsed = 0;
+}
+
+//adds a job on top of the ones already in the frame, the region gets copied
+static struct TFWCTileJob *tileAddJob(struct TFWCTileCompositor *tc, pixman_region32_t *region) {
+    if(tc->jobCount == tc->jobCapacity) {
+        tc->jobCapacity = tc->jobCapacity ? tc->jobCapacity * 2 : 16;
+        tc->jobs = realloc(tc->jobs, tc->jobCapacity * sizeof(struct TFWCTileJob));
+    }
+    struct TFWCTileJob *job = &tc->jobs[tc->jobCount++];
+    memset(job, 0, sizeof(struct TFWCTileJob));
+    pixman_region32_init(&job->region);
+    pixman_region32_copy(&job->region, region);
+    return job;
+}
+
+//throws away the jobs of a frame without drawing them
+//makes room for length bytes of copied pixels, returns where they go in the staging buffer
+static size_t tileStage(struct TFWCTileCompositor *tc, size_t length) {
+    size_t offset = tc->stagingUsed;
+    if(offset + length > tc->stagingSize) {
+        tc->stagingSize = tc->stagingSize ? tc->stagingSize * 2 : 1 << 20;
+        while(tc->stagingSize < offset + length) tc->stagingSize *= 2;
+        tc->staging = realloc(tc->staging, tc->stagingSize);
+    }
+    tc->stagingUsed += length;
+    return offset;
+}
+
+static void tileCompositorAbort(struct TFWCTileCompositor *tc) {
+    for(int i = 0; i < tc->jobCount; i++) pixman_region32_fini(&tc->jobs[i].region);
+    tc->jobCount = 0;
+}
+
+//draws the frame, the main thread works on tiles too and this only returns once all of them are done
+static void tileCompositorRun(struct TFWCTileCompositor *tc, pixman_region32_t *damage) {
+    //only tiles that actually have damage in them are worth handing out
+    pixman_box32_t *extents = pixman_region32_extents(damage);
+    tc->tileCount = 0;
+    for(int y = extents->y1 - extents->y1 % tileSize; y < extents->y2; y += tileSize) {
+        for(int x = extents->x1 - extents->x1 % tileSize; x < extents->x2; x += tileSize) {
+            pixman_box32_t box = { x, y, x + tileSize, y + tileSize };
+            if(pixman_region32_contains_rectangle(damage, &box) == PIXMAN_REGION_OUT) continue;
+            if(tc->tileCount == tc->tileCapacity) {
+                tc->tileCapacity = tc->tileCapacity ? tc->tileCapacity * 2 : 64;
+                tc->tiles = realloc(tc->tiles, tc->tileCapacity * sizeof(pixman_box32_t));
+            }
+            tc->tiles[tc->tileCount++] = box;
+        }
+    }
+    tc->nextTile = 0;
+    for(int i = 0; i < tc->jobCount; i++) {
+        if(tc->jobs[i].staged) tc->jobs[i].data = (uint32_t *)(tc->staging + tc->jobs[i].offset);
+    }
+
+    if(tc->threads > 1) {
+        pthread_mutex_lock(&tc->lock);
+        tc->generation++;
+        tc->running = tc->threads - 1;
+        pthread_cond_broadcast(&tc->wake);
+        pthread_mutex_unlock(&tc->lock);
+    }
+    tileWork(tc);
+    if(tc->threads > 1) {
+        pthread_mutex_lock(&tc->lock);
+        while(tc->running > 0) pthread_cond_wait(&tc->finished, &tc->lock);
+        pthread_mutex_unlock(&tc->lock);
+    }
+    tileCompositorAbort(tc);
+}
+
+//window rendering functions
+
+//limits drawing to one rectangle of the damaged area, which is in untransformed output coordinates
+static void scissorOutput(struct wlr_output *wlrOutput, struct wlr_renderer *renderer, pixman_box32_t *rect) {
+    struct wlr_box box = {
+        .x = rect->x1,
+        .y = rect->y1,
+        .width = rect->x2 - rect->x1,
+        .height = rect->y2 - rect->y1,
+    };
+    int width, height;
+    wlr_output_transformed_resolution(wlrOutput, &width, &height);
+    enum wl_output_transform transform = wlr_output_transform_invert(wlrOutput->transform);
+    wlr_box_transform(&box, &box, transform, width, height);
+    wlr_renderer_scissor(renderer, &box);
+}
+
+//main window rendering function
+static void renderWindow(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct renderData *rdata = data;
+    struct wlr_output *output = rdata->output;
+
+    //we get the texture of the window, basicly what it contains
+    struct wlr_texture *texture = wlr_surface_get_texture(surface);
+    if(texture == NULL) {
+        rdata->stats->texturesMissing++;
+        return;
+    }
+
+    //the screen coordinates of the window were worked out once for all its surfaces
+    int ox = rdata->ox + sx, oy = rdata->oy + sy;
+
+    //we scale the window to the corect dpi, and a viewport might only show part of its buffer
+    struct wlr_box box = surfaceOutputBox(surface, ox, oy, output->scale);
+    struct wlr_fbox source;
+    wlr_surface_get_buffer_source_box(surface, &source);
+
+    //only the damaged part of the window has to be drawn again
+    pixman_region32_t damage;
+    pixman_region32_init_rect(&damage, box.x, box.y, box.width, box.height);
+    pixman_region32_intersect(&damage, &damage, rdata->damage);
+    if(pixman_region32_not_empty(&damage)) {
+        //we define a matrix transform for rendering the texture to the screen
+        float matrix[9];
+        enum wl_output_transform transform = wlr_output_transform_invert(surface->current.transform);
+        wlr_matrix_project_box(matrix, &box, transform, 0, output->transform_matrix);
+
+        //we render the window to the screen, one damaged rectangle at a time
+        int nrects;
+        pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
+        for(int i = 0; i < nrects; i++) {
+            scissorOutput(output, rdata->renderer, &rects[i]);
+            wlr_render_subtexture_with_matrix(rdata->renderer, texture, &source, matrix, 1);
+        }
+        rdata->surfacesDrawn++;
+
+        //surfaces that dont match their box pixel for pixel have to be resampled, which costs fill rate and blurs them
+        bool rotated = surface->current.transform & WL_OUTPUT_TRANSFORM_90;
+        if(source.width != (rotated ? box.height : box.width) || source.height != (rotated ? box.width : box.height)) rdata->stats->surfacesScaled++;
+    }
+    pixman_region32_fini(&damage);
+}
+
+//tells a surface that its frame has been shown so it can draw the next one
+static void sendFrameDone(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct timespec *when = data;
+    wlr_surface_send_frame_done(surface, when);
+}
+
+//tells the presentation time protocol that a surface is part of the frame thats about to be committed
+static void surfaceSampled(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct TFWCOutput *output = data;
+    wlr_presentation_surface_sampled_on_output(output->server->presentation, surface, output->wlrOutput);
+}
+
+//commits a frame to a monitor, everything that has to happen on every commit goes through here
+static bool commitOutput(struct TFWCOutput *output) {
+    struct TFWCServer *server = output->server;
+
+    //windows that can be seen on this monitor get presentation feedback from this commit
+    //and in benchmark mode they remember which commit shows their content so the present event can time it
+    struct TFWCView *view;
+    wl_list_for_each(view, &server->views, link) {
+        if(!view->mapped || !viewOnOutput(view, output) || (view->occludedOutputs & output->bit)) continue;
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, surfaceSampled, output);
+        //commit_seq only counts up during the commit, and the present event carries the new value
+        if(server->bench && view->benchCommitPending) view->benchCommitSeq = output->wlrOutput->commit_seq + 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t trace = traceBegin();
+    //the present event for this commit carries the sequence number after it got bumped
+    uint32_t seq = output->wlrOutput->commit_seq + 1;
+    //only a frame that actually gets committed can miss its deadline, some backends present before the commit returns
+    output->targetVblankNs = output->aimedVblankNs;
+    bool committed = wlr_output_commit(output->wlrOutput);
+    if(!committed) output->targetVblankNs = 0;
+    traceEnd(trace, "output_commit", output->traceTrack, "seq", seq);
+    histogramRecord(&output->stats.commitTime, nsSince(&start));
+    if(!committed) output->stats.framesDropped++;
+    if(committed && server->firstFrameNs == 0) {
+        server->firstFrameNs = startupPhase(server, "startup_first_frame");
+        wlr_log(WLR_INFO, "first frame on %s %.1fms after start", output->wlrOutput->name, (server->firstFrameNs - server->startNs) / 1e6);
+    }
+    return committed;
+}
+
+//called when a committed frame actually got shown
+static void outputPresent(struct wl_listener *listener, void *data) {
+    struct TFWCOutput *output = wl_container_of(listener, output, present);
+    struct wlr_output_event_present *event = data;
+    if(!event->presented) return;
+    traceInstant("present", output->traceTrack, timespecNs(event->when), "seq", event->commit_seq);
+
+    //the vblank timing is what the render deadline gets scheduled against
+    output->lastPresentNs = timespecNs(event->when);
+    if(event->refresh > 0) output->refreshNs = event->refresh;
+    if(output->targetVblankNs != 0) {
+        if(output->lastPresentNs > output->targetVblankNs + output->refreshNs / 2) {
+            output->stats.deadlinesMissed++;
+            output->marginNs *= 2;
+            if(output->marginNs > output->refreshNs / 2) output->marginNs = output->refreshNs / 2;
+        } else if(output->marginNs > 1000000) {
+            output->marginNs -= output->marginNs / 64;
+        }
+        output->targetVblankNs = 0;
+    }
+
+    struct TFWCBench *bench = output->server->bench;
+    if(bench == NULL || !bench->measuring) return;
+    struct TFWCView *view;
+    wl_list_for_each(view, &output->server->views, link) {
+        if(!view->benchCommitPending || view->benchCommitSeq != event->commit_seq) continue;
+        histogramRecord(&bench->commitToPresent, timespecNs(event->when) - timespecNs(&view->benchCommitTime));
+        view->benchCommitPending = false;
+    }
+}
+
+//counts the surfaces of a window
+static void countSurface(struct wlr_surface *surface, int sx, int sy, void *data) {
+    int *count = data;
+    (*count)++;
+}
+
+//whether a cursor is drawn in software on top of the monitor contents
+static bool hasSoftwareCursor(struct wlr_output *wlrOutput) {
+    struct wlr_output_cursor *cursor;
+    wl_list_for_each(cursor, &wlrOutput->cursors, link) {
+        if(cursor->enabled && cursor->visible && cursor != wlrOutput->hardware_cursor) return true;
+    }
+    return false;
+}
+
+//tells the output what changed since the last frame, it wants its damage transformed the same way the buffer is
+static void setOutputDamage(struct TFWCOutput *output) {
+    struct wlr_output *wlrOutput = output->wlrOutput;
+    int width, height;
+    wlr_output_transformed_resolution(wlrOutput, &width, &height);
+    pixman_region32_t frameDamage;
+    pixman_region32_init(&frameDamage);
+    enum wl_output_transform transform = wlr_output_transform_invert(wlrOutput->transform);
+    wlr_region_transform(&frameDamage, &output->damage->current, transform, width, height);
+    wlr_output_set_damage(wlrOutput, &frameDamage);
+    pixman_region32_fini(&frameDamage);
+}
+
+//tries to show the topmost window directly on the monitor without compositing it, returns true if it took care of the frame
+static bool scanOutView(struct TFWCOutput *output) {
+    struct TFWCServer *server = output->server;
+    struct wlr_output *wlrOutput = output->wlrOutput;
+
+    //only the topmost window on this monitor can be scanned out
+    struct TFWCView *view = NULL, *iter;
+    wl_list_for_each(iter, &server->views, link) {
+        if(!iter->mapped || !viewOnOutput(iter, output)) continue;
+        view = iter;
+        break;
+    }
+    if(view == NULL) return false;
+
+    //it has to be a single surface without popups or subsurfaces on top
+    struct wlr_surface *surface = view->xdgSurface->surface;
+    if(surface->buffer == NULL) return false;
+    int nsurfaces = 0;
+    wlr_xdg_surface_for_each_surface(view->xdgSurface, countSurface, &nsurfaces);
+    if(nsurfaces != 1) return false;
+
+    //its buffer has to line up with the monitor pixel for pixel
+    //the buffer scale or viewport dont matter as long as the whole buffer is shown at the size of the monitor
+    if(surface->current.transform != wlrOutput->transform) return false;
+    if(surface->current.viewport.has_src) return false;
+    if(surface->buffer->base.width != wlrOutput->width || surface->buffer->base.height != wlrOutput->height) return false;
+
+    //and cover all of it
+    struct wlr_box *outputBox = &output->layoutBox;
+    if(view->x != outputBox->x || view->y != outputBox->y) return false;
+    if(surface->current.width != outputBox->width || surface->current.height != outputBox->height) return false;
+
+    //theres no background behind it, so it has to be opaque
+    pixman_box32_t surfaceBox = { 0, 0, surface->current.width, surface->current.height };
+    if(pixman_region32_contains_rectangle(&surface->opaque_region, &surfaceBox) != PIXMAN_REGION_IN) return false;
+
+    //a software cursor would have to be composited on top
+    if(hasSoftwareCursor(wlrOutput)) return false;
+
+    wlr_output_attach_buffer(wlrOutput, &surface->buffer->base);
+    if(!wlr_output_test(wlrOutput)) {
+        wlr_output_rollback(wlrOutput);
+        return false;
+    }
+    //when the same window stays scanned out only what got damaged since the last frame changed, screen recorders get told just that
+    //this is all the damage that piled up and not just the last commit, since a window can commit several times per frame
+    if(output->scanoutView == view) setOutputDamage(output);
+    output->scanoutView = view;
+    return commitOutput(output);
+}
+
+//adds the opaque part of a surface to the region covered on a monitor
+static void addOpaqueRegion(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct opaqueData *odata = data;
+    if(!pixman_region32_not_empty(&surface->opaque_region)) return;
+    pixman_region32_t opaque;
+    pixman_region32_init(&opaque);
+    pixman_region32_copy(&opaque, &surface->opaque_region);
+    pixman_region32_intersect_rect(&opaque, &opaque, 0, 0, surface->current.width, surface->current.height);
+    pixman_region32_translate(&opaque, odata->ox + sx, odata->oy + sy);
+    //scaled edges are rounded inward so only pixels that are fully covered count as opaque
+    //at fractional scales the filtering also blends one more pixel into the edge so that one is dropped too
+    int margin = odata->scale == floorf(odata->scale) ? 0 : 1;
+    int rectCount;
+    pixman_box32_t *rects = pixman_region32_rectangles(&opaque, &rectCount);
+    for(int i = 0; i < rectCount; i++) {
+        int x1 = ceilf(rects[i].x1 * odata->scale) + margin;
+        int y1 = ceilf(rects[i].y1 * odata->scale) + margin;
+        int x2 = floorf(rects[i].x2 * odata->scale) - margin;
+        int y2 = floorf(rects[i].y2 * odata->scale) - margin;
+        if(x2 > x1 && y2 > y1) pixman_region32_union_rect(odata->opaque, odata->opaque, x1, y1, x2 - x1, y2 - y1);
+    }
+    pixman_region32_fini(&opaque);
+}
+
+//hands a surface of a window to the tiled compositor, if its buffer lines up with the monitor pixel for pixel
+//thats the case at any scale for clients that draw at the size the buffer scale or a viewport asks for
+static void tileSurface(struct wlr_surface *surface, int sx, int sy, void *data) {
+    struct tileData *tdata = data;
+    if(tdata->failed) return;
+    struct wlr_texture *texture = wlr_surface_get_texture(surface);
+    if(texture == NULL) {
+        tdata->output->stats.texturesMissing++;
+        return;
+    }
+    struct wlr_box box = surfaceOutputBox(surface, tdata->ox + sx, tdata->oy + sy, tdata->output->wlrOutput->scale);
+    if(!wlr_texture_is_pixman(texture) || surface->current.viewport.has_src || surface->current.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+        (int)texture->width != box.width || (int)texture->height != box.height) {
+        tdata->failed = true;
+        return;
+    }
+    pixman_image_t *image = wlr_pixman_texture_get_image(texture);
+    struct wlr_buffer *source = surface->buffer ? surface->buffer->source : NULL;
+
+    pixman_region32_t region;
+    pixman_region32_init(&region);
+    pixman_region32_intersect_rect(&region, tdata->visible, box.x, box.y, box.width, box.height);
+    if(!pixman_region32_not_empty(&region)) {
+        pixman_region32_fini(&region);
+        return;
+    }
 
-    //activate new surface
-    wlr_xdg_toplevel_set_activated(view->xdgSurface, true);
-    wlr_seat_keyboard_notify_enter(seat, view->xdgSurface->surface, keyboard->keycodes, keyboard->num_keycodes, &keyboard->modifiers);
+    //client pixels are shm the client can shrink under us, which raises SIGBUS, and libwayland only guards the thread that began the access
+    //so the visible part gets copied here on the main thread and the workers only ever read the copy
+    void *pixels;
+    uint32_t drmFormat;
+    size_t stride;
+    if(source == NULL || !wlr_buffer_begin_data_ptr_access(source, WLR_BUFFER_DATA_PTR_ACCESS_READ, &pixels, &drmFormat, &stride)) {
+        pixman_region32_fini(&region);
+        tdata->failed = true;
+        return;
+    }
+    struct TFWCTileCompositor *tc = tdata->output->server->tiles;
+    pixman_box32_t *extents = pixman_region32_extents(&region);
+    pixman_format_code_t format = pixman_image_get_format(image);
+    int bytesPerPixel = PIXMAN_FORMAT_BPP(format) / 8;
+    int width = extents->x2 - extents->x1, height = extents->y2 - extents->y1;
+    int stagedStride = (width * bytesPerPixel + 3) & ~3;
+    size_t offset = tileStage(tc, (size_t)stagedStride * height);
+    const char *from = (const char *)pixels + (size_t)(extents->y1 - box.y) * stride + (size_t)(extents->x1 - box.x) * bytesPerPixel;
+    for(int row = 0; row < height; row++) memcpy(tc->staging + offset + (size_t)row * stagedStride, from + (size_t)row * stride, width * bytesPerPixel);
+    wlr_buffer_end_data_ptr_access(source);
+
+    struct TFWCTileJob *job = tileAddJob(tc, &region);
+    job->staged = true;
+    job->offset = offset;
+    job->format = format;
+    job->width = width;
+    job->height = height;
+    job->stride = stagedStride;
+    job->x = extents->x1;
+    job->y = extents->y1;
+    tdata->surfacesDrawn++;
+    pixman_region32_fini(&region);
 }
 
-//handle clipboard setting requests
-static void seatRequestSetSelection(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, requestSetSelection);
-    struct wlr_seat_request_set_selection_event *event = data;
-    wlr_seat_set_selection(server->seat, event->source, event->serial);
-}
+//draws a frame with the tiled software compositor, returns false if it cant so the renderer has to do it
+//this only works on the pixman renderer without transforms, and only if every buffer maps onto the monitor 1:1 so it just gets copied or blended
+static bool compositeTiled(struct TFWCOutput *output, pixman_region32_t *damage, pixman_region32_t *background, float color[4], int *surfacesDrawn) {
+    struct TFWCServer *server = output->server;
+    struct wlr_output *wlrOutput = output->wlrOutput;
+    struct TFWCTileCompositor *tc = server->tiles;
+    if(tc == NULL || wlrOutput->transform != WL_OUTPUT_TRANSFORM_NORMAL) return false;
+    pixman_image_t *target = wlr_pixman_renderer_get_current_image(server->renderer);
+    if(target == NULL) return false;
+    tileCompositorBegin(tc, pixman_image_get_data(target), pixman_image_get_format(target),
+        pixman_image_get_width(target), pixman_image_get_height(target), pixman_image_get_stride(target));
+
+    //same color conversion the pixman renderer does for the background
+    struct TFWCTileJob *job = tileAddJob(tc, background);
+    job->color = (pixman_color_t){
+        .red = color[0] * 0xffff,
+        .green = color[1] * 0xffff,
+        .blue = color[2] * 0xffff,
+        .alpha = color[3] * 0xffff,
+    };
 
-//mouse stuff
+    struct TFWCView *view;
+    struct tileData tdata = {
+        .output = output,
+    };
+    wl_list_for_each_reverse(view, &server->views, link) {
+        if(!view->mapped || !viewOnOutput(view, output) || !pixman_region32_not_empty(&view->visible)) continue;
+        tdata.ox = view->x - output->layoutBox.x;
+        tdata.oy = view->y - output->layoutBox.y;
+        tdata.visible = &view->visible;
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, tileSurface, &tdata);
+        if(tdata.failed) {
+            tileCompositorAbort(tc);
+            return false;
+        }
+    }
 
-//handle programs sending custom cursor images
-static void seatRequestCursor(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, requestCursor);
-    struct wlr_seat_pointer_request_set_cursor_event *event = data;
-    struct wlr_seat_client *focused_client = server->seat->pointer_state.focused_client;
-    if(focused_client == event->seat_client) wlr_cursor_set_surface(server->cursor, event->surface, event->hotspot_x, event->hotspot_y);
+    tileCompositorRun(tc, damage);
+    *surfacesDrawn = tdata.surfacesDrawn;
+    return true;
 }
 
-//handle cursor motion events
-static void processCursorMotion(struct TFWCServer *server, uint32_t time) {
-    double sx, sy;
-    struct wlr_seat *seat = server->seat;
-    struct wlr_surface *surface = NULL;
-    struct TFWCView *view = desktop_view_at(server, server->cursor->x, server->cursor->y, &surface, &sx, &sy);
-    if (!view) { //if cursor isnt over a window will it default to the normal pointer
-        wlr_xcursor_manager_set_cursor_image(server->cursorManager, "left_ptr", server->cursor);
+//draws the damaged part of a monitor, the damage is in untransformed output coordinates
+static void compositeOutput(struct TFWCOutput *output, pixman_region32_t *damage) {
+    struct wlr_output *wlrOutput = output->wlrOutput;
+    struct wlr_renderer *renderer = output->server->renderer;
+
+    //going from the top down, every window only has to draw what isnt covered by opaque windows above it
+    //windows on other monitors are skipped entirely
+    pixman_region32_t opaque;
+    pixman_region32_init(&opaque);
+    struct TFWCView *view;
+    wl_list_for_each(view, &output->server->views, link) {
+        if(!view->mapped || !viewOnOutput(view, output)) continue;
+        pixman_region32_subtract(&view->visible, damage, &opaque);
+        if(!pixman_region32_not_empty(&view->visible)) continue;
+        struct opaqueData odata = {
+            .scale = wlrOutput->scale,
+            .ox = view->x - output->layoutBox.x,
+            .oy = view->y - output->layoutBox.y,
+            .opaque = &opaque,
+        };
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, addOpaqueRegion, &odata);
     }
-    if (surface) {
-        wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
-        wlr_seat_pointer_notify_motion(seat, time, sx, sy);
-    } else {
-        wlr_seat_pointer_clear_focus(seat);
+
+    wlr_renderer_begin(renderer, wlrOutput->width, wlrOutput->height);
+
+    //backgrownd is set to a solid color, only where no opaque window covers it
+    float color[4] = {0.3, 0.3, 0.3, 1.0};
+    pixman_region32_t background;
+    pixman_region32_init(&background);
+    pixman_region32_subtract(&background, damage, &opaque);
+    pixman_region32_fini(&opaque);
+
+    int surfacesDrawn = 0;
+    if(!compositeTiled(output, damage, &background, color, &surfacesDrawn)) {
+        int nrects;
+        pixman_box32_t *rects = pixman_region32_rectangles(&background, &nrects);
+        for(int i = 0; i < nrects; i++) {
+            scissorOutput(wlrOutput, renderer, &rects[i]);
+            wlr_renderer_clear(renderer, color);
+        }
+
+        wl_list_for_each_reverse(view, &output->server->views, link) {
+            if(!view->mapped || !viewOnOutput(view, output) || !pixman_region32_not_empty(&view->visible)) continue;
+            struct renderData rdata = {
+                    .output = wlrOutput,
+                    .view = view,
+                    .ox = view->x - output->layoutBox.x,
+                    .oy = view->y - output->layoutBox.y,
+                    .renderer = renderer,
+                    .damage = &view->visible,
+                    .stats = &output->stats,
+            };
+            wlr_xdg_surface_for_each_surface(view->xdgSurface, renderWindow, &rdata);
+            surfacesDrawn += rdata.surfacesDrawn;
+        }
     }
-}
+    pixman_region32_fini(&background);
+    output->stats.surfacesDrawn += surfacesDrawn;
+    histogramRecord(&output->stats.surfacesPerFrame, surfacesDrawn);
 
-//handle relative cursor movement envents
-static void serverCursorMotion(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, cursorMotion);
-    struct wlr_event_pointer_motion *event = data;
-    wlr_cursor_move(server->cursor, event->device, event->delta_x, event->delta_y);
-    processCursorMotion(server, event->time_msec);
-}
+    //cursors only get drawn here when the monitor has no hardware cursor plane for them
+    wlr_output_render_software_cursors(wlrOutput, damage);
 
-//handle absolute cursor events, like drawing pads send for example
-static void serverCursorMotionAbsolute(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, cursorMotionAbsolute);
-    struct wlr_event_pointer_motion_absolute *event = data;
-    wlr_cursor_warp_absolute(server->cursor, event->device, event->x, event->y);
-    processCursorMotion(server, event->time_msec);
+    wlr_renderer_scissor(renderer, NULL);
+    wlr_renderer_end(renderer);
 }
 
-//handle mouse clicks
-static void serverCursorButton(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, cursorButton);
-    struct wlr_event_pointer_button *event = data;
-    wlr_seat_pointer_notify_button(server->seat, event->time_msec, event->button, event->state);
-    double sx, sy;
-    struct wlr_surface *surface;
-    struct TFWCView *view = desktop_view_at(server,server->cursor->x, server->cursor->y, &surface, &sx, &sy);
-    focus_view(view, surface);
+//works out which windows are completely covered by opaque windows above them on a monitor
+static void updateOcclusion(struct TFWCOutput *output) {
+    pixman_region32_t covered;
+    pixman_region32_init(&covered);
+    struct TFWCView *view;
+    wl_list_for_each(view, &output->server->views, link) {
+        if(!view->mapped || !viewOnOutput(view, output)) continue;
+        struct wlr_box box;
+        wlr_box_intersection(&box, &view->extents, &output->layoutBox);
+        pixman_box32_t rect = { box.x, box.y, box.x + box.width, box.y + box.height };
+        if(pixman_region32_contains_rectangle(&covered, &rect) == PIXMAN_REGION_IN) {
+            view->occludedOutputs |= output->bit;
+            continue;
+        }
+        view->occludedOutputs &= ~output->bit;
+        struct opaqueData odata = {
+            .scale = 1,
+            .ox = view->x,
+            .oy = view->y,
+            .opaque = &covered,
+        };
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, addOpaqueRegion, &odata);
+    }
+    pixman_region32_fini(&covered);
 }
 
-//handle frame events
-static void serverCursorFrame(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, cursorFrame);
-    wlr_seat_pointer_notify_frame(server->seat);
-}
+//main rendering function
+static void renderOutput(struct TFWCOutput *output) {
+    struct wlr_output *wlrOutput = output->wlrOutput;
+    uint64_t trace = traceBegin();
 
-//handle axis events such as scrolling
-static void serverCursorAxis(struct wl_listener *listener, void *data) {
-    struct TFWCServer *server = wl_container_of(listener, server, cursorAxis);
-    struct wlr_event_pointer_axis *event = data;
-    wlr_seat_pointer_notify_axis(server->seat, event->time_msec, event->orientation, event->delta, event->delta_discrete, event->source);
-}
+    struct TFWCView *view;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-//window rendering functions
+    bool needsFrame;
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    updateOcclusion(output);
 
-//main window rendering function
-static void renderWindow(struct wlr_surface *surface, int sx, int sy, void *data) {
-    struct renderData *rdata = data;
-    struct TFWCView *view = rdata->view;
-    struct wlr_output *output = rdata->output;
+    //a control socket batch is still waiting for windows to take their new size, it should show up all in one frame
+    if(output->server->batchPending > 0) {
+        output->stats.framesHeld++;
+        goto frameDone;
+    }
 
-    //we get the texture of the window, basicly what it contains
-    struct wlr_texture *texture = wlr_surface_get_texture(surface);
-    if(texture == NULL) return;
+    //nothing changed since a window was scanned out, so its buffer is still on screen
+    if(output->scannedOut && !wlrOutput->needs_frame && !pixman_region32_not_empty(&output->damage->current)) {
+        output->stats.framesSkipped++;
+        goto frameDone;
+    }
 
-    //we get the specific screen coordinates from the whole desktop coordinates
-    double ox = 0, oy = 0;
-    wlr_output_layout_output_coords(view->server->outputLayout, output, &ox, &oy);
-    ox += view->x + sx, oy += view->y + sy;
+    //a fullscreen window can skip compositing entirely
+    if(scanOutView(output)) {
+        if(!output->scannedOut) {
+            wlr_log(WLR_DEBUG, "%s: direct scanout started (%" PRIu64 " frames scanned out, %" PRIu64 " composited)",
+                wlrOutput->name, output->stats.framesScannedOut, output->stats.framesComposited);
+        }
+        output->scannedOut = true;
+        output->stats.framesScannedOut++;
+        goto frameDone;
+    }
+    if(output->scannedOut) {
+        //the swapchain buffers didnt see the frames that were scanned out, so their damage history is useless
+        wlr_log(WLR_DEBUG, "%s: direct scanout stopped (%" PRIu64 " frames scanned out, %" PRIu64 " composited)",
+            wlrOutput->name, output->stats.framesScannedOut, output->stats.framesComposited);
+        output->scannedOut = false;
+        output->scanoutView = NULL;
+        wlr_output_damage_add_whole(output->damage);
+    }
 
-    //we scale the window to the corect dpi
-    struct wlr_box box = {
-        .x = ox * output->scale,
-        .y = oy * output->scale,
-        .width = surface->current.width * output->scale,
-        .height = surface->current.height * output->scale,
-    };
+    //we initiate renderer stuff, the damage we get back already accounts for the age of the buffer we render into
+    if(!wlr_output_damage_attach_render(output->damage, &needsFrame, &damage)) {
+        output->stats.framesDropped++;
+        goto frameDone;
+    }
 
-    //we define a matrix transform for rendering the texture to the screen
-    float matrix[9];
-    enum wl_output_transform transform = wlr_output_transform_invert(surface->current.transform);
-    wlr_matrix_project_box(matrix, &box, transform, 0, output->transform_matrix);
+    //nothing changed so we dont render or commit anything
+    if(!needsFrame) {
+        wlr_output_rollback(wlrOutput);
+        output->stats.framesSkipped++;
+        goto frameDone;
+    }
+
+    //if only a hardware cursor moved the buffer is already up to date and the commit just moves the cursor plane
+    if(pixman_region32_not_empty(&damage)) {
+        struct timespec renderStart;
+        clock_gettime(CLOCK_MONOTONIC, &renderStart);
+        uint64_t compositeTrace = traceBegin();
+        compositeOutput(output, &damage);
+        traceEnd(compositeTrace, "composite", output->traceTrack, NULL, 0);
+        histogramRecord(&output->stats.renderTime, nsSince(&renderStart));
+        output->stats.framesComposited++;
+    }
+
+    setOutputDamage(output);
+    bool committed = commitOutput(output);
+    output->recentFrameNs[output->recentFrameIndex++ % 32] = nsSince(&now);
+    if(committed && output->server->bench && output->server->bench->measuring) {
+        output->server->bench->frames++;
+        histogramRecord(&output->server->bench->frameTime, nsSince(&now));
+    }
 
-    //we render the window to the screen
-    wlr_render_texture_with_matrix(rdata->renderer, texture, matrix, 1);
+frameDone:
+    pixman_region32_fini(&damage);
+    output->aimedVblankNs = 0;
 
-    //and then lastly tell wl that its rendered
-    wlr_surface_send_frame_done(surface, rdata->when);
+    //windows get their frame callbacks even when nothing had to be redrawn, otherwise they would wait forever
+    //hidden windows get theirs from the slow timer instead, so they dont keep drawing frames nobody sees
+    wl_list_for_each(view, &output->server->views, link) {
+        if(!viewOnOutput(view, output) || viewHidden(view)) continue;
+        wlr_xdg_surface_for_each_surface(view->xdgSurface, sendFrameDone, &now);
+    }
+    traceEnd(trace, "render", output->traceTrack, NULL, 0);
 }
 
-//main rendering function
+//how many milliseconds rendering can wait so it still finishes right before the next vblank, 0 if it should start now
+static int renderDelay(struct TFWCOutput *output) {
+    if(output->maxRenderTime == 0 || output->lastPresentNs == 0) return 0;
+    uint64_t refresh = output->refreshNs;
+    if(refresh == 0 && output->wlrOutput->refresh > 0) refresh = 1000000000000ull / output->wlrOutput->refresh;
+    if(refresh == 0) return 0;
+
+    //a fixed budget, or the slowest of the last frames plus a margin that adapts to missed deadlines
+    uint64_t budget = (uint64_t)output->maxRenderTime * 1000000;
+    if(output->maxRenderTime < 0) {
+        budget = 0;
+        for(int i = 0; i < 32; i++) {
+            if(output->recentFrameNs[i] > budget) budget = output->recentFrameNs[i];
+        }
+        budget += output->marginNs;
+    }
+    if(budget >= refresh) return 0;
+
+    struct timespec nowTs;
+    clock_gettime(CLOCK_MONOTONIC, &nowTs);
+    uint64_t now = timespecNs(&nowTs);
+    uint64_t nextVblank = output->lastPresentNs + refresh;
+    if(now >= output->lastPresentNs) nextVblank = output->lastPresentNs + ((now - output->lastPresentNs) / refresh + 1) * refresh;
+
+    //if the deadline already passed the frame goes out right away and lands on the vblank after
+    if(nextVblank - budget <= now) return 0;
+    output->aimedVblankNs = nextVblank;
+    return (nextVblank - budget - now) / 1000000;
+}
+
+//render deadline timer, by now everything that came in during the refresh cycle is part of the frame
+static int renderTimerFired(void *data) {
+    struct TFWCOutput *output = data;
+    output->renderPending = false;
+    renderOutput(output);
+    return 0;
+}
+
+//frame event handler, renders right away or waits for the render deadline so late input and commits still make this frame
 static void renderScreen(struct wl_listener *listener, void *data) {
     struct TFWCOutput *output = wl_container_of(listener, output, frame);
-    struct wlr_renderer *renderer = output->server->renderer;
+    if(output->server->outputsOff) return;
+    if(output->renderPending) return;
+    int delay = renderDelay(output);
+    traceInstant("frame", output->traceTrack, 0, "delay_ms", delay);
+    if(delay <= 0) {
+        renderOutput(output);
+        return;
+    }
+    output->renderPending = true;
+    output->stats.framesDelayed++;
+    wl_event_source_timer_update(output->renderTimer, delay);
+}
 
+//answers the frame callbacks of windows nobody can see at a low rate, so they dont hang but also dont waste time drawing
+static int hiddenFrameTick(void *data) {
+    struct TFWCServer *server = data;
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
+    struct TFWCView *view;
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) {
+            if(viewHidden(view)) wlr_xdg_surface_for_each_surface(view->xdgSurface, sendFrameDone, &now);
+        }
+    }
+    wl_event_source_timer_update(server->hiddenFrameTimer, hiddenFrameInterval);
+    return 0;
+}
 
-    //we initiate renderer stuff
-    if (!wlr_output_attach_render(output->wlrOutput, NULL)) return;
-    int width, height;
-    wlr_output_effective_resolution(output->wlrOutput, &width, &height);
-    wlr_renderer_begin(renderer, width, height);
-
-    //backgrownd is set to a solid color
-    float color[4] = {0.3, 0.3, 0.3, 1.0};
-    wlr_renderer_clear(renderer, color);
+//called when a monitor is unplugged
+static void outputDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCOutput *output = wl_container_of(listener, output, destroy);
+    struct TFWCServer *server = output->server;
 
+    //the bit gets reused by the next monitor, so no window can keep it
     struct TFWCView *view;
-    wl_list_for_each_reverse(view, &output->server->views, link) {
-        if(!view->mapped) continue;
-        struct renderData rdata = {
-                .output = output->wlrOutput,
-                .view = view,
-                .renderer = renderer,
-                .when = &now,
-        };
-        wlr_xdg_surface_for_each_surface(view->xdgSurface, renderWindow, &rdata);
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) {
+            view->outputs &= ~output->bit;
+            view->occludedOutputs &= ~output->bit;
+        }
     }
+    output->server->outputBits &= ~output->bit;
+
+    wl_event_source_remove(output->renderTimer);
+    wl_list_remove(&output->frame.link);
+    wl_list_remove(&output->destroy.link);
+    wl_list_remove(&output->present.link);
+    wl_list_remove(&output->link);
+    free(output);
+    updateFractionalScales(server);
+}
 
-    //we render the cursor
-    wlr_output_render_software_cursors(output->wlrOutput, NULL);
-
-    wlr_renderer_end(renderer);
-    wlr_output_commit(output->wlrOutput);
+//writes the statistics of every monitor as json, to the file named in TFWC_STATS_FILE or to stderr
+static int dumpStats(int signalNumber, void *data) {
+    struct TFWCServer *server = data;
+    const char *path = getenv("TFWC_STATS_FILE");
+    FILE *file = path ? fopen(path, "w") : stderr;
+    if(file == NULL) {
+        wlr_log_errno(WLR_ERROR, "failed to open stats file %s", path);
+        return 0;
+    }
+    fprintf(file, "{\"first_frame_ms\": %.1f, \"outputs\": [", server->firstFrameNs ? (server->firstFrameNs - server->startNs) / 1e6 : 0.0);
+    struct TFWCOutput *output;
+    bool first = true;
+    wl_list_for_each(output, &server->outputs, link) {
+        struct TFWCOutputStats *stats = &output->stats;
+        fprintf(file, "%s{\"name\": \"%s\", \"frames_composited\": %" PRIu64 ", \"frames_scanned_out\": %" PRIu64
+            ", \"frames_skipped\": %" PRIu64 ", \"frames_dropped\": %" PRIu64
+            ", \"frames_delayed\": %" PRIu64 ", \"deadlines_missed\": %" PRIu64 ", \"frames_held\": %" PRIu64
+            ", \"surfaces_drawn\": %" PRIu64 ", \"surfaces_scaled\": %" PRIu64 ", \"textures_missing\": %" PRIu64 ", ",
+            first ? "" : ", ", output->wlrOutput->name, stats->framesComposited, stats->framesScannedOut,
+            stats->framesSkipped, stats->framesDropped, stats->framesDelayed, stats->deadlinesMissed, stats->framesHeld,
+            stats->surfacesDrawn, stats->surfacesScaled, stats->texturesMissing);
+        histogramPrintJson(file, "render_time_us", &stats->renderTime, true);
+        fprintf(file, ", ");
+        histogramPrintJson(file, "commit_time_us", &stats->commitTime, true);
+        fprintf(file, ", ");
+        histogramPrintJson(file, "surfaces_per_frame", &stats->surfacesPerFrame, false);
+        fprintf(file, "}");
+        first = false;
+    }
+    fprintf(file, "], \"clients\": [");
+    struct TFWCClient *client;
+    first = true;
+    wl_list_for_each(client, &server->clients, link) {
+        pid_t pid;
+        wl_client_get_credentials(client->client, &pid, NULL, NULL);
+        fprintf(file, "%s{\"pid\": %d, \"buffers\": %" PRIu32 ", \"buffer_bytes\": %" PRIu64 ", \"peak_buffer_bytes\": %" PRIu64 "}",
+            first ? "" : ", ", (int)pid, client->buffers, client->bufferBytes, client->peakBytes);
+        first = false;
+    }
+    fprintf(file, "]}\n");
+    if(path) fclose(file);
+    else fflush(file);
+    return 0;
 }
 
 //called when a window should be shown
 static void xdgUnHideWindow(struct wl_listener *listener, void *data) {
     struct TFWCView *view = wl_container_of(listener, view, map);
     view->mapped = true;
+    updateViewExtents(view);
+    if(viewShown(view)) damageBox(view->server, &view->extents);
+    ipcEmit(view, TFWC_IPC_EVENT_MAP);
 }
 
 //called when a window shouldnt be renderered
 static void xdgHideWindow(struct wl_listener *listener, void *data) {
     struct TFWCView *view = wl_container_of(listener, view, unmap);
+    if(viewShown(view)) damageBox(view->server, &view->extents);
     view->mapped = false;
+    gridUpdateView(view);
+    if(view->server->grabbedView == view) endInteractive(view->server);
+    batchViewDone(view);
+    ipcEmit(view, TFWC_IPC_EVENT_UNMAP);
+}
+
+//called when a window submits new content
+static void xdgCommitWindow(struct wl_listener *listener, void *data) {
+    struct TFWCView *view = wl_container_of(listener, view, commit);
+    traceInstant("commit", 0, 0, "window", view->id);
+    if(!view->mapped) return;
+    if(view->server->bench && !view->benchCommitPending) {
+        clock_gettime(CLOCK_MONOTONIC, &view->benchCommitTime);
+        view->benchCommitPending = true;
+        view->benchCommitSeq = UINT32_MAX;
+    }
+    struct wlr_box oldExtents = view->extents;
+
+    //when resizing from the left or top, the opposite edge has to stay where it was once the new size arrives
+    //sizes still queued up when the button is let go arrive after the grab ended, so this lasts until the client caught up
+    struct TFWCServer *server = view->server;
+    if(view->anchorEdges != 0) {
+        struct wlr_box geo_box;
+        wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
+        if(view->anchorEdges & WLR_EDGE_LEFT) view->x = view->anchorRight - geo_box.width - geo_box.x;
+        if(view->anchorEdges & WLR_EDGE_TOP) view->y = view->anchorBottom - geo_box.height - geo_box.y;
+        if(server->grabbedView != view && view->resizeSerial == 0 && !view->resizeQueued) view->anchorEdges = 0;
+    }
+
+    //a control socket batch resized the window, now that the new size is here it moves too and the batch can be shown once all its windows are done
+    if(view->batchPending && view->resizeSerial == 0 && !view->resizeQueued) batchViewDone(view);
+
+    updateViewExtents(view);
+    if(!viewShown(view)) {
+        //windows on other workspaces only keep their extents and grid cells up to date for when they get shown again
+        if(memcmp(&oldExtents, &view->extents, sizeof(struct wlr_box)) != 0) ipcEmit(view, TFWC_IPC_EVENT_GEOMETRY);
+    } else if(memcmp(&oldExtents, &view->extents, sizeof(struct wlr_box)) != 0) {
+        //the window changed size so both where it was and where it is now have to be redrawn
+        damageBox(view->server, &oldExtents);
+        damageBox(view->server, &view->extents);
+        ipcEmit(view, TFWC_IPC_EVENT_GEOMETRY);
+    } else {
+        damageView(view, view->xdgSurface->surface, false);
+    }
+    
+    //make sure a frame comes even if the commit didnt damage anything, so frame callbacks get answered
+    if(!server->outputsOff && !viewHidden(view) && !wl_list_empty(&view->xdgSurface->surface->current.frame_callback_list)) {
+        struct TFWCOutput *output;
+        wl_list_for_each(output, &view->server->outputs, link) {
+            if(viewOnOutput(view, output)) wlr_output_schedule_frame(output->wlrOutput);
+        }
+    }
+}
+
+//called when a popup or subsurface submits new content
+static void childCommit(struct wl_listener *listener, void *data) {
+    struct TFWCChild *child = wl_container_of(listener, child, commit);
+    struct TFWCView *view = child->view;
+    traceInstant("commit_child", 0, 0, "window", view ? view->id : 0);
+    if(view == NULL || !view->mapped) return;
+    struct wlr_box oldExtents = view->extents;
+    updateViewExtents(view);
+    if(!viewShown(view)) return;
+    if(memcmp(&oldExtents, &view->extents, sizeof(struct wlr_box)) != 0) damageBox(view->server, &oldExtents);
+    damageView(view, child->surface, false);
+}
+
+//called when a popup or subsurface gets hidden
+static void childUnmap(struct wl_listener *listener, void *data) {
+    struct TFWCChild *child = wl_container_of(listener, child, unmap);
+    if(child->view == NULL) return;
+    if(viewShown(child->view)) damageBox(child->view->server, &child->view->extents);
+}
+
+static void childNewPopup(struct wl_listener *listener, void *data);
+static void childNewSubsurface(struct wl_listener *listener, void *data);
+
+//called when a popup or subsurface is freed from memory
+static void childDestroy(struct wl_listener *listener, void *data) {
+    struct TFWCChild *child = wl_container_of(listener, child, destroy);
+    wl_list_remove(&child->commit.link);
+    wl_list_remove(&child->unmap.link);
+    wl_list_remove(&child->newPopup.link);
+    wl_list_remove(&child->newSubsurface.link);
+    wl_list_remove(&child->destroy.link);
+    wl_list_remove(&child->link);
+    free(child);
+}
+
+//starts tracking a child surface, popups also get to open popups of their own
+static struct TFWCChild *trackChild(struct TFWCView *view, struct wlr_surface *surface) {
+    struct TFWCChild *child = calloc(1, sizeof(struct TFWCChild));
+    child->server = view->server;
+    child->view = view;
+    wl_list_insert(&view->children, &child->link);
+    child->surface = surface;
+    child->commit.notify = childCommit;
+    wl_signal_add(&surface->events.commit, &child->commit);
+    child->newSubsurface.notify = childNewSubsurface;
+    wl_signal_add(&surface->events.new_subsurface, &child->newSubsurface);
+    child->unmap.notify = childUnmap;
+    child->destroy.notify = childDestroy;
+    wl_list_init(&child->newPopup.link);
+
+    //its on the same monitors as its window, later changes get sent to all surfaces of the window
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &view->server->outputs, link) {
+        if(view->outputs & output->bit) wlr_surface_send_enter(surface, output->wlrOutput);
+    }
+    return child;
+}
+
+static void trackPopup(struct TFWCView *view, struct wlr_xdg_popup *wlrPopup) {
+    struct TFWCChild *child = trackChild(view, wlrPopup->base->surface);
+    wl_signal_add(&wlrPopup->base->events.unmap, &child->unmap);
+    wl_signal_add(&wlrPopup->base->events.destroy, &child->destroy);
+    child->newPopup.notify = childNewPopup;
+    wl_signal_add(&wlrPopup->base->events.new_popup, &child->newPopup);
+}
+
+static void trackSubsurface(struct TFWCView *view, struct wlr_subsurface *subsurface) {
+    struct TFWCChild *child = trackChild(view, subsurface->surface);
+    wl_signal_add(&subsurface->events.unmap, &child->unmap);
+    wl_signal_add(&subsurface->events.destroy, &child->destroy);
+}
+
+//called when a popup opens a popup of its own
+static void childNewPopup(struct wl_listener *listener, void *data) {
+    struct TFWCChild *parent = wl_container_of(listener, parent, newPopup);
+    if(parent->view != NULL) trackPopup(parent->view, data);
+}
+
+//called when a popup or subsurface gets a subsurface of its own
+static void childNewSubsurface(struct wl_listener *listener, void *data) {
+    struct TFWCChild *parent = wl_container_of(listener, parent, newSubsurface);
+    if(parent->view != NULL) trackSubsurface(parent->view, data);
+}
+
+//called when a window opens a popup
+static void xdgNewWindowPopup(struct wl_listener *listener, void *data) {
+    struct TFWCView *view = wl_container_of(listener, view, newPopup);
+    trackPopup(view, data);
+}
+
+//called when a window gets a subsurface, like a video player embedded in a browser
+static void xdgNewWindowSubsurface(struct wl_listener *listener, void *data) {
+    struct TFWCView *view = wl_container_of(listener, view, newSubsurface);
+    trackSubsurface(view, data);
 }
 
 //clalled when a window shouldnt be rendered again at all and be freed from memory
 static void xdgDestroyWindow(struct wl_listener *listener, void *data) {
     struct TFWCView *view = wl_container_of(listener, view, destroy);
+    batchViewDone(view);
+    struct TFWCView **slot = &view->server->viewIds[view->id & (viewIdBuckets - 1)];
+    while(*slot != view) slot = &(*slot)->idNext;
+    *slot = view->idNext;
+    gridRemoveView(view);
     wl_list_remove(&view->link);
+    wl_list_remove(&view->map.link);
+    wl_list_remove(&view->unmap.link);
+    wl_list_remove(&view->destroy.link);
+    wl_list_remove(&view->requestMove.link);
+    wl_list_remove(&view->requestResize.link);
+    wl_list_remove(&view->commit.link);
+    wl_list_remove(&view->newPopup.link);
+    wl_list_remove(&view->newSubsurface.link);
+    wl_list_remove(&view->ackConfigure.link);
+    pixman_region32_fini(&view->visible);
+
+    //a client can destroy the xdg surface and keep committing to its subsurfaces, which then belong to no window
+    struct TFWCChild *child, *tmp;
+    wl_list_for_each_safe(child, tmp, &view->children, link) {
+        child->view = NULL;
+        wl_list_remove(&child->link);
+        wl_list_init(&child->link);
+    }
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &view->server->outputs, link) {
+        if(output->scanoutView == view) output->scanoutView = NULL;
+    }
     free(view);
 }
 
@@ -367,9 +3243,7 @@ static void xdgHandleToplevelMoveRequest(struct wl_listener *listener, void *dat
     struct TFWCServer *server = view->server;
     struct wlr_surface *focused_surface = server->seat->pointer_state.focused_surface;
     if(view->xdgSurface->surface != focused_surface) return;
-    server->grabbedView = view;
-    server->grabedX = server->cursor->x - view->x;
-    server->grabedY = server->cursor->y - view->y;
+    beginInteractive(view, TFWC_CURSOR_MOVE, 0);
 }
 
 //called when a window tries to resize it self
@@ -379,14 +3253,7 @@ static void xdgHandleToplevelResizeRequest(struct wl_listener *listener, void *d
     struct TFWCServer *server = view->server;
     struct wlr_surface *focused_surface = server->seat->pointer_state.focused_surface;
     if(view->xdgSurface->surface != focused_surface) return;
-    server->grabbedView = view;
-    struct wlr_box geo_box;
-    wlr_xdg_surface_get_geometry(view->xdgSurface, &geo_box);
-    server->grabedX = server->cursor->x;
-    server->grabedY = server->cursor->y;
-    server->grabGeobox = geo_box;
-    server->grabGeobox.x += view->x;
-    server->grabGeobox.y += view->y;
+    beginInteractive(view, TFWC_CURSOR_RESIZE, event->edges);
 }
 
 //called when a new window is started
@@ -399,6 +3266,9 @@ static void serverNewWindow(struct wl_listener *listener, void *data) {
     struct TFWCView *view = calloc(1, sizeof(struct TFWCView));
     view->server = server;
     view->xdgSurface = xdgSurface;
+    xdgSurface->data = view;
+    pixman_region32_init(&view->visible);
+    wl_list_init(&view->children);
 
     //Listen to the various events it can emit
     view->map.notify = xdgUnHideWindow;
@@ -412,39 +3282,112 @@ static void serverNewWindow(struct wl_listener *listener, void *data) {
     wl_signal_add(&toplevel->events.request_move, &view->requestMove);
     view->requestResize.notify = xdgHandleToplevelResizeRequest;
     wl_signal_add(&toplevel->events.request_resize, &view->requestResize);
-
-    //Add it to the list of views.
+    view->commit.notify = xdgCommitWindow;
+    wl_signal_add(&xdgSurface->surface->events.commit, &view->commit);
+    view->newPopup.notify = xdgNewWindowPopup;
+    wl_signal_add(&xdgSurface->events.new_popup, &view->newPopup);
+    view->newSubsurface.notify = xdgNewWindowSubsurface;
+    wl_signal_add(&xdgSurface->surface->events.new_subsurface, &view->newSubsurface);
+    view->ackConfigure.notify = xdgAckConfigure;
+    wl_signal_add(&xdgSurface->events.ack_configure, &view->ackConfigure);
+
+    //Add it to the list of views, new windows open on the workspace being shown
+    view->workspace = server->activeWorkspace;
     wl_list_insert(&server->views, &view->link);
+    view->stackOrder = ++server->stackCounter;
+
+    //give it an id for the control socket, 0 is never used so scripts can treat it as no window
+    if(++server->viewIdCounter == 0) server->viewIdCounter++;
+    view->id = server->viewIdCounter;
+    view->idNext = server->viewIds[view->id & (viewIdBuckets - 1)];
+    server->viewIds[view->id & (viewIdBuckets - 1)] = view;
 }
 
 //handling of new in and out devices
 
+//called when monitors get added, removed, moved or change size, which can change which windows are on which monitor
+static void serverLayoutChange(struct wl_listener *listener, void *data) {
+    struct TFWCServer *server = wl_container_of(listener, server, layoutChange);
+    struct TFWCOutput *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        struct wlr_box *box = wlr_output_layout_get_box(server->outputLayout, output->wlrOutput);
+        struct wlr_box layoutBox = box ? *box : (struct wlr_box){ 0 };
+        if(memcmp(&layoutBox, &output->layoutBox, sizeof(struct wlr_box)) == 0) continue;
+        output->layoutBox = layoutBox;
+        wlr_output_damage_add_whole(output->damage);
+    }
+    struct TFWCView *view;
+    for(int i = 0; i < workspaceCount; i++) {
+        wl_list_for_each(view, workspaceViews(server, i), link) updateViewOutputs(view);
+    }
+    updateFractionalScales(server);
+
+    //a monitor that got added or changed its scale might need the cursor theme at a new scale
+    if(loadCursorThemes(server) && server->cursorImage != NULL) {
+        const char *cursorImage = server->cursorImage;
+        server->cursorImage = NULL;
+        setCursorImage(server, cursorImage);
+    }
+}
+
 //event for when a new monitor is connected
 static void serverNewOutput(struct wl_listener *listener, void *data) {
     struct TFWCServer *server = wl_container_of(listener, server, newOutput);
     struct wlr_output *wlrOutput = data;
 
+    //the monitor sets of windows are 32 bits, so more monitors than that are left off
+    if(~server->outputBits == 0) {
+        wlr_log(WLR_ERROR, "monitor %s not used, only 32 monitors are supported", wlrOutput->name);
+        return;
+    }
+
 	wlr_output_init_render(wlrOutput, server->allocator, server->renderer);
 
-    //setting monitor modes
+    //setting monitor modes, headless and nested monitors dont have any but still have to be enabled
     if(!wl_list_empty(&wlrOutput->modes)) {
 	struct wlr_output_mode *mode = wlr_output_preferred_mode(wlrOutput);
 	wlr_output_set_mode(wlrOutput, mode);
-	wlr_output_enable(wlrOutput, true);
-	if(!wlr_output_commit(wlrOutput)) return;
     }
+    wlr_output_enable(wlrOutput, true);
+    if(!wlr_output_commit(wlrOutput)) return;
 
     struct TFWCOutput *output = calloc(1, sizeof(struct TFWCOutput));
     output->wlrOutput = wlrOutput;
     output->server = server;
+    output->traceTrack = ++server->traceTracks;
+    output->bit = 1u << __builtin_ctz(~server->outputBits);
+    server->outputBits |= output->bit;
+
+    //our destroy listener has to run before the damage tracker frees itself
+    output->destroy.notify = outputDestroy;
+    wl_signal_add(&wlrOutput->events.destroy, &output->destroy);
 
-    //set up event for frame notify
+    //set up damage tracking, a new monitor starts out fully damaged
+    output->damage = wlr_output_damage_create(wlrOutput);
+    wlr_output_damage_add_whole(output->damage);
     output->frame.notify = renderScreen;
-    wl_signal_add(&wlrOutput->events.frame, &output->frame);
+    wl_signal_add(&output->damage->events.frame, &output->frame);
     wl_list_insert(&server->outputs, &output->link);
+    output->present.notify = outputPresent;
+    wl_signal_add(&wlrOutput->events.present, &output->present);
+
+    //render deadline scheduling, TFWC_MAX_RENDER_TIME is off, auto or a number of milliseconds
+    const char *maxRenderTime = getenv("TFWC_MAX_RENDER_TIME");
+    if(maxRenderTime == NULL || strcmp(maxRenderTime, "off") == 0) output->maxRenderTime = 0;
+    else if(strcmp(maxRenderTime, "auto") == 0) output->maxRenderTime = -1;
+    else output->maxRenderTime = atoi(maxRenderTime);
+    output->marginNs = 1000000;
+    output->renderTimer = wl_event_loop_add_timer(wl_display_get_event_loop(server->display), renderTimerFired, output);
     
-    //auto layouts screens for now
+    //auto layouts screens for now, the layout change handler takes care of the cached position
     wlr_output_layout_add_auto(server->outputLayout, wlrOutput);
+
+    //adding it to the layout loaded the cursor theme at its scale if needed, and the new monitor needs the current image
+    const char *cursorImage = server->cursorImage;
+    if(cursorImage != NULL) {
+        server->cursorImage = NULL;
+        setCursorImage(server, cursorImage);
+    }
 }
 
 //event for when a new input device is connected
@@ -458,17 +3401,15 @@ static void serverNewInput(struct wl_listener *listener, void *data) {
             keyboard->device = device;
 
             //set correct keymap and rules for the new keyboard
-            struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
             struct xkb_rule_names rules = { 0 };
             rules.rules = getenv("XKB_DEFAULT_RULES");
             rules.model = getenv("XKB_DEFAULT_MODEL");
             rules.layout = getenv("XKB_DEFAULT_LAYOUT");
             rules.variant = getenv("XKB_DEFAULT_VARIANT");
             rules.options = getenv("XKB_DEFAULT_OPTIONS");
-            struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
-            wlr_keyboard_set_keymap(device->keyboard, keymap);
-            xkb_keymap_unref(keymap);
-            xkb_context_unref(context);
+            struct xkb_keymap *keymap = getKeymap(server, &rules);
+            if(keymap != NULL) wlr_keyboard_set_keymap(device->keyboard, keymap);
+            else wlr_log(WLR_ERROR, "failed to compile a keymap for %s", device->name);
             wlr_keyboard_set_repeat_info(device->keyboard, 25, 600);
 
             //define listeners for the new keyboard
@@ -495,26 +3436,379 @@ static void serverNewInput(struct wl_listener *listener, void *data) {
     wlr_seat_set_capabilities(server->seat, caps);
 }
 
+//benchmarks
+
+static volatile uintptr_t benchSink;
+
+static double elapsedNs(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+//measures how long narrowing down the windows under the pointer takes with and without the grid
+//every window the linear walk visits would have cost a full per surface test, so those are counted too
+static int benchHitTest(void) {
+    const int viewCounts[] = { 10, 100, 1000 };
+    const int queries = 200000;
+    double *points = malloc(queries * 2 * sizeof(double));
+    printf("views\tlinear_ns\tgrid_ns\tlinear_tests\tgrid_tests\n");
+    for(size_t n = 0; n < sizeof(viewCounts) / sizeof(viewCounts[0]); n++) {
+        struct TFWCServer server = { 0 };
+        wl_list_init(&server.outputs);
+        wl_list_init(&server.views);
+        server.grid = workspaceGrid(&server, 0);
+
+        //random windows spread over a 4k desktop
+        srand(1);
+        for(int i = 0; i < viewCounts[n]; i++) {
+            struct TFWCView *view = calloc(1, sizeof(struct TFWCView));
+            view->server = &server;
+            view->mapped = true;
+            view->extents.width = 200 + rand() % 1000;
+            view->extents.height = 150 + rand() % 700;
+            view->extents.x = view->x = rand() % (3840 - view->extents.width);
+            view->extents.y = view->y = rand() % (2160 - view->extents.height);
+            wl_list_insert(&server.views, &view->link);
+            view->stackOrder = ++server.stackCounter;
+            gridUpdateView(view);
+        }
+        for(int i = 0; i < queries * 2; i += 2) {
+            points[i] = rand() % 3840 + 0.5;
+            points[i + 1] = rand() % 2160 + 0.5;
+        }
+
+        struct timespec start, end;
+        struct TFWCView *view;
+        long linearTests = 0, gridTests = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int i = 0; i < queries * 2; i += 2) {
+            wl_list_for_each(view, &server.views, link) {
+                linearTests++;
+                if(wlr_box_contains_point(&view->extents, points[i], points[i + 1])) break;
+            }
+            benchSink += (uintptr_t)view;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double linearNs = elapsedNs(&start, &end) / queries;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int i = 0; i < queries * 2; i += 2) {
+            view = gridViewAt(&server, points[i], points[i + 1], UINT64_MAX);
+            gridTests += view != NULL;
+            benchSink += (uintptr_t)view;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double gridNs = elapsedNs(&start, &end) / queries;
+
+        printf("%d\t%.1f\t%.1f\t%.2f\t%.2f\n", viewCounts[n], linearNs, gridNs,
+            (double)linearTests / queries, (double)gridTests / queries);
+
+        struct TFWCView *tmp;
+        wl_list_for_each_safe(view, tmp, &server.views, link) free(view);
+        for(int i = 0; i < gridBuckets; i++) free(server.grid[i].entries);
+        free(server.grid);
+    }
+    free(points);
+    return 0;
+}
+
+//composites a 4k frame of overlapping opaque and translucent windows with the tiled compositor on 1, 2, 4 and 8 threads
+//every thread count has to give exactly the same pixels as the single threaded run
+static int benchComposite(void) {
+    const int width = 3840, height = 2160, windows = 32, frames = 30;
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    uint32_t *frame = malloc(width * height * 4);
+    uint32_t *reference = malloc(width * height * 4);
+    pixman_region32_t damage;
+    pixman_region32_init_rect(&damage, 0, 0, width, height);
+
+    //every other window is premultiplied argb with an alpha gradient, the rest are opaque xrgb
+    srand(1);
+    struct TFWCTileJob *sources = calloc(windows, sizeof(struct TFWCTileJob));
+    for(int i = 0; i < windows; i++) {
+        struct TFWCTileJob *source = &sources[i];
+        source->width = 400 + rand() % 1200;
+        source->height = 300 + rand() % 800;
+        source->x = rand() % (width - source->width / 2);
+        source->y = rand() % (height - source->height / 2);
+        source->stride = source->width * 4;
+        source->format = i % 2 ? PIXMAN_a8r8g8b8 : PIXMAN_x8r8g8b8;
+        source->data = malloc(source->stride * source->height);
+        for(int y = 0; y < source->height; y++) {
+            for(int x = 0; x < source->width; x++) {
+                uint32_t alpha = i % 2 ? (x * 255 / source->width) : 255;
+                uint32_t r = (x + i * 40) & 0xff, g = (y + i * 70) & 0xff, b = (x ^ y) & 0xff;
+                source->data[y * source->width + x] = alpha << 24 | (r * alpha / 255) << 16 | (g * alpha / 255) << 8 | b * alpha / 255;
+            }
+        }
+        pixman_region32_init_rect(&source->region, source->x, source->y, source->width, source->height);
+        pixman_region32_intersect_rect(&source->region, &source->region, 0, 0, width, height);
+    }
+
+    printf("threads\tframe_ms\tspeedup\tidentical\n");
+    double serialNs = 0;
+    for(size_t n = 0; n < sizeof(threadCounts) / sizeof(threadCounts[0]); n++) {
+        struct TFWCTileCompositor *tc = tileCompositorCreate(threadCounts[n]);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int f = 0; f < frames; f++) {
+            tileCompositorBegin(tc, frame, PIXMAN_x8r8g8b8, width, height, width * 4);
+            struct TFWCTileJob *job = tileAddJob(tc, &damage);
+            job->color = (pixman_color_t){ 0x4ccc, 0x4ccc, 0x4ccc, 0xffff };
+            for(int i = 0; i < windows; i++) {
+                job = tileAddJob(tc, &sources[i].region);
+                pixman_region32_t region = job->region;
+                *job = sources[i];
+                job->region = region;
+            }
+            tileCompositorRun(tc, &damage);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = elapsedNs(&start, &end) / frames;
+        if(n == 0) {
+            serialNs = ns;
+            memcpy(reference, frame, width * height * 4);
+        }
+        bool identical = memcmp(reference, frame, width * height * 4) == 0;
+        printf("%d\t%.2f\t%.2f\t%s\n", tc->threads, ns / 1e6, serialNs / ns, identical ? "yes" : "no");
+        tileCompositorDestroy(tc);
+        if(!identical) return 1;
+    }
+
+    for(int i = 0; i < windows; i++) {
+        pixman_region32_fini(&sources[i].region);
+        free(sources[i].data);
+    }
+    free(sources);
+    pixman_region32_fini(&damage);
+    free(reference);
+    free(frame);
+    return 0;
+}
+
+//replays the scripted input of the benchmark, the pointer traces a lissajous curve over the desktop at 1000hz in bursts of four every 4ms
+//every half second it clicks, which raises the window under it, and every second the bottom window gets raised
+static int benchInputTick(void *data) {
+    struct TFWCBench *bench = data;
+    struct TFWCServer *server = bench->server;
+    uint32_t step = bench->step++;
+    uint32_t time = step * 4;
+
+    struct wlr_box *box = wlr_output_layout_get_box(server->outputLayout, NULL);
+    if(box != NULL && !wlr_box_empty(box)) {
+        //four motion events per tick like a 1000hz mouse would send
+        for(int i = 0; i < 4; i++) {
+            double t = step * 0.004 + i * 0.001;
+            double x = box->x + box->width * (0.5 + 0.45 * sin(t * 1.3));
+            double y = box->y + box->height * (0.5 + 0.45 * sin(t * 1.7 + 1.0));
+            wlr_cursor_warp_closest(server->cursor, NULL, x, y);
+            queueCursorMotion(server, time + i);
+            wlr_seat_pointer_notify_frame(server->seat);
+        }
+    }
+
+    if(step % 125 == 0) {
+        processCursorButton(server, time, 0x110, WLR_BUTTON_PRESSED);
+        processCursorButton(server, time, 0x110, WLR_BUTTON_RELEASED);
+    }
+
+    if(step % 250 == 125) {
+        struct TFWCView *view;
+        wl_list_for_each_reverse(view, &server->views, link) {
+            if(!view->mapped) continue;
+            focus_view(view, view->xdgSurface->surface);
+            break;
+        }
+    }
+
+    wl_event_source_timer_update(bench->inputTimer, 4);
+    return 0;
+}
+
+//prints the benchmark results as json on stdout
+static void benchReport(struct TFWCBench *bench) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("{\"clients\": %d, \"rate_hz\": %d, \"duration_s\": %d, \"frames\": %" PRIu64 ", ",
+        bench->clients, bench->rate, bench->duration, bench->frames);
+    histogramPrintJson(stdout, "frame_time_us", &bench->frameTime, true);
+    printf(", ");
+    histogramPrintJson(stdout, "hit_test_ns", &bench->hitTest, false);
+    printf(", ");
+    histogramPrintJson(stdout, "commit_to_present_us", &bench->commitToPresent, true);
+    printf(", \"first_frame_ms\": %.1f, \"peak_rss_kb\": %ld}\n",
+        bench->server->firstFrameNs ? (bench->server->firstFrameNs - bench->server->startNs) / 1e6 : 0.0, usage.ru_maxrss);
+    fflush(stdout);
+
+    //the clients commit the whole run, so no latency samples means presents stopped being matched to commits
+    if(bench->commitToPresent.total == 0) {
+        fprintf(stderr, "benchmark measured no commit to present latency\n");
+        bench->failed = true;
+    }
+}
+
+//the first second lets the clients connect and map their windows, then the measured run starts, then the results get printed
+static int benchPhase(void *data) {
+    struct TFWCBench *bench = data;
+    if(!bench->measuring) {
+        bench->measuring = true;
+        bench->frames = 0;
+        memset(&bench->frameTime, 0, sizeof(struct TFWCHistogram));
+        memset(&bench->hitTest, 0, sizeof(struct TFWCHistogram));
+        memset(&bench->commitToPresent, 0, sizeof(struct TFWCHistogram));
+        wl_event_source_timer_update(bench->phaseTimer, bench->duration * 1000);
+        return 0;
+    }
+    benchReport(bench);
+    wl_display_terminate(bench->server->display);
+    return 0;
+}
+
+//starts the synthetic clients and the input script once the compositor is running
+static bool benchStart(struct TFWCBench *bench) {
+    struct wl_event_loop *loop = wl_display_get_event_loop(bench->server->display);
+    char clients[16], rate[16];
+    snprintf(clients, sizeof(clients), "%d", bench->clients);
+    snprintf(rate, sizeof(rate), "%d", bench->rate);
+    char *const argv[] = { (char *)bench->clientPath, "-n", clients, "-r", rate, NULL };
+    bench->clientPid = spawnProgram(argv);
+    if(bench->clientPid < 0) return false;
+    bench->inputTimer = wl_event_loop_add_timer(loop, benchInputTick, bench);
+    wl_event_source_timer_update(bench->inputTimer, 4);
+    bench->phaseTimer = wl_event_loop_add_timer(loop, benchPhase, bench);
+    wl_event_source_timer_update(bench->phaseTimer, 1000);
+    return true;
+}
+
+static void benchFinish(struct TFWCBench *bench) {
+    wl_event_source_remove(bench->inputTimer);
+    wl_event_source_remove(bench->phaseTimer);
+    if(bench->clientPid > 0) {
+        kill(bench->clientPid, SIGTERM);
+        waitpid(bench->clientPid, NULL, 0);
+    }
+}
+
 //main function duh
 int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        { "bench", no_argument, NULL, 'b' },
+        { "bench-clients", required_argument, NULL, 'c' },
+        { "bench-rate", required_argument, NULL, 'r' },
+        { "bench-duration", required_argument, NULL, 'd' },
+        { "bench-hittest", no_argument, NULL, 'H' },
+        { "bench-composite", no_argument, NULL, 'C' },
+        { 0 },
+    };
+    struct TFWCBench bench = {
+        .clients = 16,
+        .rate = 60,
+        .duration = 10,
+    };
+    bool benchMode = false;
+    int opt;
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch(opt) {
+            case 'b':
+                benchMode = true;
+                break;
+            case 'c':
+                bench.clients = atoi(optarg);
+                break;
+            case 'r':
+                bench.rate = atoi(optarg);
+                break;
+            case 'd':
+                bench.duration = atoi(optarg);
+                break;
+            case 'H':
+                return benchHitTest();
+            case 'C':
+                return benchComposite();
+            default:
+                fprintf(stderr, "usage: %s [--bench [--bench-clients N] [--bench-rate HZ] [--bench-duration SECONDS]] [--bench-hittest] [--bench-composite]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    //the benchmark client lives next to the compositor binary
+    char clientPath[PATH_MAX];
+    char *self = strdup(argv[0]);
+    snprintf(clientPath, sizeof(clientPath), "%s/TFWC-benchclient", dirname(self));
+    free(self);
+    bench.clientPath = clientPath;
+
+    //startup gets timed up to the first frame, and traced too with TFWC_TRACE set
+    struct TFWCServer server = { 0 };
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    server.startNs = server.startupPhaseNs = timespecNs(&startTime);
+#ifndef TFWC_NO_TRACE
+    traceEnabled = getenv("TFWC_TRACE") != NULL;
+#endif
+
     //start main wayland things
-    struct TFWCServer server;
     server.display = wl_display_create();
-    server.backend = wlr_backend_autocreate(server.display);
+    if(benchMode) {
+        //the benchmark has to run on machines without a gpu or a seat
+        server.bench = &bench;
+        bench.server = &server;
+        setenv("WLR_RENDERER", "pixman", false);
+        server.backend = wlr_headless_backend_create(server.display);
+        wlr_headless_add_output(server.backend, 1920, 1080);
+    } else {
+        server.backend = wlr_backend_autocreate(server.display);
+    }
     server.renderer = wlr_renderer_autocreate(server.backend);
     wlr_renderer_init_wl_display(server.renderer, server.display);
     server.allocator = wlr_allocator_autocreate(server.backend, server.renderer);
-    wlr_compositor_create(server.display, server.renderer);
+    startupPhase(&server, "startup_renderer");
+
+    //the tiled software compositor is opt in, and only for the pixman renderer
+    const char *renderThreads = getenv("TFWC_RENDER_THREADS");
+    if(renderThreads != NULL && atoi(renderThreads) > 0) {
+        if(wlr_renderer_is_pixman(server.renderer)) server.tiles = tileCompositorCreate(atoi(renderThreads));
+        else wlr_log(WLR_INFO, "TFWC_RENDER_THREADS only applies to the pixman renderer");
+    }
+    struct wlr_compositor *compositor = wlr_compositor_create(server.display, server.renderer);
+    server.newSurface.notify = serverNewSurface;
+    wl_signal_add(&compositor->events.new_surface, &server.newSurface);
     wlr_data_device_manager_create(server.display);
+    server.presentation = wlr_presentation_create(server.display, server.backend);
+
+    //idle tracking, TFWC_IDLE_TIMEOUT is how many seconds without input it takes for the monitors to turn off
+    server.idle = wlr_idle_create(server.display);
+    server.idleInhibitManager = wlr_idle_inhibit_v1_create(server.display);
+    server.newIdleInhibitor.notify = serverNewIdleInhibitor;
+    wl_signal_add(&server.idleInhibitManager->events.new_inhibitor, &server.newIdleInhibitor);
+    const char *idleTimeout = getenv("TFWC_IDLE_TIMEOUT");
+    if(idleTimeout != NULL) server.idleTimeout = atoi(idleTimeout) * 1000;
+
+    //client buffer memory accounting, TFWC_CLIENT_MEMORY_LIMIT caps it at that many megabytes per client
+    wl_list_init(&server.clients);
+    const char *memoryLimit = getenv("TFWC_CLIENT_MEMORY_LIMIT");
+    if(memoryLimit != NULL) server.clientMemoryLimit = strtoull(memoryLimit, NULL, 10) << 20;
+
+    //viewports and fractional scales let clients draw buffers at the exact pixel size of a monitor with a fractional scale
+    //those get drawn 1:1 instead of being resampled
+    wlr_viewporter_create(server.display);
+    wl_list_init(&server.fractionalScales);
+    wl_global_create(server.display, &wp_fractional_scale_manager_v1_interface, 1, &server, fractionalScaleManagerBind);
+
+    //screen capture, every commit carries its damage so recorders using copy_with_damage only wake up when something changed
+    wlr_screencopy_manager_v1_create(server.display);
 
     //screen layout and new screen connection listener
     server.outputLayout = wlr_output_layout_create();
     wl_list_init(&server.outputs);
     server.newOutput.notify = serverNewOutput;
     wl_signal_add(&server.backend->events.new_output, &server.newOutput);
+    server.layoutChange.notify = serverLayoutChange;
+    wl_signal_add(&server.outputLayout->events.change, &server.layoutChange);
 
     //new window listener
     wl_list_init(&server.views);
+    for(int i = 0; i < workspaceCount; i++) wl_list_init(&server.workspaces[i].views);
+    server.grid = workspaceGrid(&server, 0);
     server.xdgShell = wlr_xdg_shell_create(server.display);
     server.newXdgWindow.notify = serverNewWindow;
     wl_signal_add(&server.xdgShell->events.new_surface, &server.newXdgWindow);
@@ -522,8 +3816,9 @@ int main(int argc, char *argv[]) {
     //setup cursor and mouse events
     server.cursor = wlr_cursor_create();
     wlr_cursor_attach_output_layout(server.cursor, server.outputLayout);
+    //the theme only gets loaded once a monitor shows up, at the scales monitors actually use
     server.cursorManager = wlr_xcursor_manager_create(NULL, 24);
-    wlr_xcursor_manager_load(server.cursorManager, 1);
+    setCursorImage(&server, "left_ptr");
     server.cursorMotion.notify = serverCursorMotion;
     wl_signal_add(&server.cursor->events.motion, &server.cursorMotion);
     server.cursorMotionAbsolute.notify = serverCursorMotionAbsolute;
@@ -537,6 +3832,7 @@ int main(int argc, char *argv[]) {
 
     //setup keyboard event stuff
     wl_list_init(&server.keyboards);
+    wl_list_init(&server.keymaps);
     server.newInput.notify = serverNewInput;
     wl_signal_add(&server.backend->events.new_input, &server.newInput);
     server.seat = wlr_seat_create(server.display, "seat0");
@@ -545,22 +3841,65 @@ int main(int argc, char *argv[]) {
     server.requestSetSelection.notify = seatRequestSetSelection;
     wl_signal_add(&server.seat->events.request_set_selection, &server.requestSetSelection);
 
+    //control socket, it gets opened once the wayland socket name is known
+    wl_list_init(&server.ipcClients);
+
+    //keybindings
+    for(size_t i = 0; i < sizeof(defaultKeybinds) / sizeof(defaultKeybinds[0]); i++) keybindAdd(&server, &defaultKeybinds[i]);
+
+    //statistics get dumped on demand, and programs we started get reaped when they exit
+    struct wl_event_loop *loop = wl_display_get_event_loop(server.display);
+    struct wl_event_source *statsSignal = wl_event_loop_add_signal(loop, SIGUSR1, dumpStats, &server);
+    struct wl_event_source *childSignal = wl_event_loop_add_signal(loop, SIGCHLD, reapChildren, &server);
+    struct wl_event_source *traceSignalSource = wl_event_loop_add_signal(loop, SIGUSR2, traceSignal, &server);
+    server.hiddenFrameTimer = wl_event_loop_add_timer(loop, hiddenFrameTick, &server);
+    wl_event_source_timer_update(server.hiddenFrameTimer, hiddenFrameInterval);
+    server.batchTimer = wl_event_loop_add_timer(loop, batchTimerFired, &server);
+    clock_gettime(CLOCK_MONOTONIC, &server.lastActivity);
+    if(server.idleTimeout > 0) {
+        server.idleTimer = wl_event_loop_add_timer(loop, idleTick, &server);
+        wl_event_source_timer_update(server.idleTimer, server.idleTimeout);
+    }
+    startupPhase(&server, "startup_globals");
+
     const char *socket = wl_display_add_socket_auto(server.display);
     if (!socket) {
         wlr_backend_destroy(server.backend);
         return 1;
     }
 
+    //starting the backend is what finds the monitors and input devices, so this is where cursor themes and keymaps get loaded
     if (!wlr_backend_start(server.backend)) {
         wlr_backend_destroy(server.backend);
         wl_display_destroy(server.display);
         return 1;
     }
+    startupPhase(&server, "startup_backend_start");
 
     setenv("WAYLAND_DISPLAY", socket, true);
+    if(!ipcCreate(&server, socket)) wlr_log(WLR_ERROR, "failed to open the control socket");
+    if(server.bench && !benchStart(server.bench)) {
+        wlr_backend_destroy(server.backend);
+        wl_display_destroy(server.display);
+        return 1;
+    }
     wl_display_run(server.display);
+    int ret = 0;
+    if(server.bench) {
+        benchFinish(server.bench);
+        if(server.bench->failed) ret = 1;
+    }
+    wl_event_source_remove(statsSignal);
+    wl_event_source_remove(childSignal);
+    wl_event_source_remove(traceSignalSource);
+    wl_event_source_remove(server.hiddenFrameTimer);
+    wl_event_source_remove(server.batchTimer);
+    ipcDestroy(&server);
+    if(server.idleTimer) wl_event_source_remove(server.idleTimer);
 
     wl_display_destroy_clients(server.display);
     wl_display_destroy(server.display);
-    return 0;
+    if(server.tiles) tileCompositorDestroy(server.tiles);
+    freeKeymaps(&server);
+    return ret;
 }